@@ -4,73 +4,804 @@ MANET Routing Protocol Performance Analyzer
 Analyzes CSV output from ns-3 simulations and generates detailed statistics
 """
 
+import argparse
+import gzip
+import hashlib
+import json
+import math
+import os
+import shutil
+import struct
+import sys
+from concurrent.futures import ProcessPoolExecutor
+from functools import lru_cache, partial
+from pathlib import Path
+
 import pandas as pd
 import numpy as np
+import matplotlib
+matplotlib.use('Agg')
 import matplotlib.pyplot as plt
 import seaborn as sns
-from pathlib import Path
-import sys
 
 # Set style for better-looking plots
 sns.set_style("whitegrid")
 plt.rcParams['figure.figsize'] = (12, 8)
 plt.rcParams['font.size'] = 10
 
+DEFAULT_PROTOCOLS = ['AODV', 'OLSR', 'DSR', 'DSDV']
+OUTPUT_SUFFIXES = ('-OUTPUT.csv', '-OUTPUT.csv.gz')
+# Screening runs write <protocol>-SCREEN-OUTPUT.csv; they are never analyzed
+SCREEN_TAG = '-SCREEN'
+CACHE_DIR = Path('.manet_cache')
+# Bump when statistics or figures change so cached artifacts are not reused
+ANALYSIS_VERSION = 2
+
+
+def find_outputs(run_dir):
+    """Map protocol name to its CSV (plain or gzipped) in one run directory,
+    leaving out screening outputs"""
+    outputs = {}
+    for path in sorted(Path(run_dir).iterdir()):
+        for suffix in OUTPUT_SUFFIXES:
+            if path.name.endswith(suffix) and not path.name[:-len(suffix)].endswith(SCREEN_TAG):
+                outputs.setdefault(path.name[:-len(suffix)], path)
+    return outputs
+
+
+def discover_runs(root):
+    """Find every directory under root that holds protocol output CSVs"""
+    runs = []
+    for dirpath, dirnames, _ in os.walk(root):
+        dirnames[:] = sorted(d for d in dirnames if not d.startswith('.'))
+        outputs = find_outputs(dirpath)
+        if outputs:
+            runs.append((Path(dirpath), outputs))
+    return runs
+
+
+def load_frame(path, cache_dir=CACHE_DIR):
+    """Parse one CSV, reusing a pickled frame while the file is unchanged.
+
+    The cache entry is named after the absolute path and is valid while the
+    file's size and mtime match the ones stored with it.
+    """
+    path = Path(path).resolve()
+    stat = path.stat()
+    key = (stat.st_size, stat.st_mtime_ns)
+
+    cache_file = None
+    if cache_dir is not None:
+        cache_file = Path(cache_dir) / (hashlib.sha1(str(path).encode()).hexdigest() + '.pkl')
+        if cache_file.exists():
+            try:
+                cached_key, df = pd.read_pickle(cache_file)
+                if cached_key == key:
+                    return df
+            except Exception:
+                pass
+
+    df = pd.read_csv(path)
+    if cache_file is not None:
+        cache_file.parent.mkdir(parents=True, exist_ok=True)
+        tmp = cache_file.with_suffix(f'.{os.getpid()}.tmp')
+        pd.to_pickle((key, df), tmp)
+        os.replace(tmp, cache_file)
+    return df
+
+
+def load_frames(paths, workers=None, cache_dir=CACHE_DIR):
+    """Load many CSVs in parallel worker processes, in input order"""
+    paths = list(paths)
+    if len(paths) <= 1 or workers == 1:
+        return [load_frame(p, cache_dir) for p in paths]
+    with ProcessPoolExecutor(max_workers=workers) as pool:
+        return list(pool.map(load_frame, paths, [cache_dir] * len(paths)))
+
+
+class ArtifactCache:
+    """Content-addressed store of per-run summaries and plot artifacts.
+
+    Objects are named by a hash of everything they derive from: the SHA-256
+    of the input CSVs, ANALYSIS_VERSION and, for figures, the figure and its
+    parameters. An unchanged run maps to the same keys on every invocation
+    (even after the results tree is moved), so only new or modified runs are
+    recomputed. File hashes are remembered by path, size and mtime so that
+    unchanged inputs are not re-read to hash them either.
+    """
+
+    def __init__(self, root=CACHE_DIR):
+        self.root = Path(root)
+        self.objects = self.root / 'objects'
+        self.index_file = self.root / 'hashes.json'
+        try:
+            with open(self.index_file) as f:
+                self.index = json.load(f)
+        except (OSError, ValueError):
+            self.index = {}
+
+    def file_hash(self, path):
+        path = Path(path).resolve()
+        stat = path.stat()
+        entry = self.index.get(str(path))
+        if entry and entry[0] == stat.st_size and entry[1] == stat.st_mtime_ns:
+            return entry[2]
+
+        h = hashlib.sha256()
+        with open(path, 'rb') as f:
+            for chunk in iter(lambda: f.read(1 << 20), b''):
+                h.update(chunk)
+        self.index[str(path)] = [stat.st_size, stat.st_mtime_ns, h.hexdigest()]
+        return h.hexdigest()
+
+    @staticmethod
+    def key(*parts):
+        return hashlib.sha256(repr((ANALYSIS_VERSION,) + parts).encode()).hexdigest()
+
+    def path(self, key, suffix):
+        return self.objects / key[:2] / (key + suffix)
+
+    def has(self, key, suffix):
+        return self.path(key, suffix).exists()
+
+    def _publish(self, key, suffix, write):
+        """Write an object through a temporary file so readers never see it partial"""
+        target = self.path(key, suffix)
+        target.parent.mkdir(parents=True, exist_ok=True)
+        tmp = target.with_suffix(f'.{os.getpid()}.tmp')
+        write(tmp)
+        os.replace(tmp, target)
+
+    def get_summary(self, key):
+        try:
+            return pd.read_pickle(self.path(key, '.pkl'))
+        except Exception:
+            return None
+
+    def put_summary(self, key, summary):
+        self._publish(key, '.pkl', lambda tmp: pd.to_pickle(summary, tmp))
+
+    def fetch(self, key, suffix, dest):
+        """Copy a cached artifact to dest; False when it is not cached"""
+        if not self.has(key, suffix):
+            return False
+        shutil.copyfile(self.path(key, suffix), dest)
+        return True
+
+    def store(self, key, suffix, src):
+        self._publish(key, suffix, lambda tmp: shutil.copyfile(src, tmp))
+
+    def save_index(self):
+        self.root.mkdir(parents=True, exist_ok=True)
+        tmp = self.index_file.with_suffix(f'.{os.getpid()}.tmp')
+        with open(tmp, 'w') as f:
+            json.dump(self.index, f)
+        os.replace(tmp, self.index_file)
+
+
+def order_protocols(names):
+    """Known protocols in their usual order, then any others alphabetically"""
+    known = [p for p in DEFAULT_PROTOCOLS if p in names]
+    return known + sorted(p for p in names if p not in DEFAULT_PROTOCOLS)
+
+
+COLORS = {'AODV': '#e41a1c', 'OLSR': '#377eb8',
+          'DSR': '#4daf4a', 'DSDV': '#984ea3'}
+PLOT_COLUMNS = ['Time', 'ThroughputKbps', 'PDR', 'AvgDelay', 'RoutingOverhead']
+MAX_PLOT_POINTS = 2000
+
+# Parameters that do not change what is simulated and therefore never split
+# runs into different scenarios. rtSnapshotInterval is not one of them:
+# reading the DSR route cache changes it.
+NON_SCENARIO_PARAMETERS = {
+    'protocol', 'verbosity', 'logFile', 'liveSocket', 'progressInterval',
+    'wallBudget', 'compress', 'codeVersion',
+    'pcapNodes', 'pcapStart', 'pcapStop', 'pcapSnapLen', 'pcapTriggerPdr',
+    'pcapTriggerHold', 'rollups', 'floodMetrics', 'loopDetection', 'queueMonitor',
+    'convergence', 'lossKernel', 'lossThreads',
+}
+
+# End-of-run values compared across replications: (key, label, higher is better).
+# PDR and delay are the final cumulative values, throughput is the rate over
+# the whole run, so no temporal variation enters the samples.
+REPLICATION_METRICS = [
+    ('final_pdr', 'Final PDR', True),
+    ('avg_throughput', 'Run Throughput (Kbps)', True),
+    ('final_delay', 'Final Avg Delay (s)', False),
+    ('total_overhead', 'Total Routing Overhead', False),
+]
+SIGNIFICANCE = 0.05
+
+
+def betainc(a, b, x):
+    """Regularized incomplete beta I_x(a, b) (continued fraction, Lentz)"""
+    if x <= 0.0:
+        return 0.0
+    if x >= 1.0:
+        return 1.0
+    if x > (a + 1.0) / (a + b + 2.0):
+        return 1.0 - betainc(b, a, 1.0 - x)
+
+    front = math.exp(math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b)
+                     + a * math.log(x) + b * math.log1p(-x)) / a
+    tiny = 1e-300
+    c, d = 1.0, 1.0 - (a + b) * x / (a + 1.0)
+    d = 1.0 / (d if abs(d) > tiny else tiny)
+    f = d
+    for m in range(1, 300):
+        for numerator in (m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m)),
+                          -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1))):
+            d = 1.0 + numerator * d
+            d = 1.0 / (d if abs(d) > tiny else tiny)
+            c = 1.0 + numerator / c
+            c = c if abs(c) > tiny else tiny
+            f *= c * d
+        if abs(c * d - 1.0) < 1e-12:
+            break
+    return front * f
+
+
+def t_test_p(t, dof):
+    """Two-sided p-value of a Student-t statistic"""
+    return betainc(dof / 2.0, 0.5, dof / (dof + t * t))
+
+
+@lru_cache(maxsize=None)
+def t95(dof):
+    """Two-sided 95% Student-t critical value, by bisection on t_test_p"""
+    if dof < 1:
+        return 0.0
+    lo, hi = 0.0, 1000.0
+    for _ in range(100):
+        mid = 0.5 * (lo + hi)
+        if t_test_p(mid, dof) > 0.05:
+            lo = mid
+        else:
+            hi = mid
+    return 0.5 * (lo + hi)
+
+
+def paired_t_test(a, b):
+    """(mean difference, p-value) of a paired t-test on a - b"""
+    diffs = np.asarray(a, dtype=float) - np.asarray(b, dtype=float)
+    n = len(diffs)
+    mean = diffs.mean()
+    sd = diffs.std(ddof=1)
+    if sd == 0.0:
+        return mean, (1.0 if mean == 0.0 else 0.0)
+    return mean, t_test_p(mean / (sd / math.sqrt(n)), n - 1)
+
+
+def holm(p_values):
+    """Holm-Bonferroni adjusted p-values, in input order"""
+    order = sorted(range(len(p_values)), key=lambda i: p_values[i])
+    adjusted = [0.0] * len(p_values)
+    running = 0.0
+    for rank, i in enumerate(order):
+        running = max(running, min(1.0, (len(p_values) - rank) * p_values[i]))
+        adjusted[i] = running
+    return adjusted
+
+
+def scenario_key(parameters):
+    return tuple(sorted((k, v) for k, v in parameters.items()
+                        if k not in NON_SCENARIO_PARAMETERS))
+
+
+def varying_parameters(keys):
+    """Names of the parameters whose value differs between scenario keys"""
+    dicts = [dict(k) for k in keys]
+    return sorted(name for name in set().union(*dicts)
+                  if len({str(d.get(name)) for d in dicts}) > 1)
+
+
+def scenario_label(key, varying):
+    """Short title built from the parameters that differ between scenarios"""
+    params = dict(key)
+    parts = [f"{name}={params[name]}" for name in varying if name in params]
+    return ', '.join(parts) if parts else 'all runs'
+
+
+def load_manifest(run_dir, protocol):
+    """The <protocol>-SUMMARY.json of a run, or None for older runs"""
+    path = Path(run_dir) / f"{protocol}-SUMMARY.json"
+    if not path.exists():
+        return None
+    with open(path) as f:
+        return json.load(f)
+
+
+def replication_id(run_dir, protocol):
+    """(scenario key, replication id) of one protocol's run.
+
+    With a manifest, runs are grouped by their simulation parameters and
+    replications are identified by RNG seed and run number, so protocols
+    run on the same seeds pair up. Without one nothing is known about the
+    scenario, so the run directory stands alone as a single replication.
+    """
+    manifest = load_manifest(run_dir, protocol)
+    if manifest is None:
+        return (('directory', str(run_dir)),), 'default'
+    rng = manifest['run']
+    return scenario_key(manifest['parameters']), f"seed={rng['seed']} run={rng['run']}"
+
+
+# Optional queue columns (written with --queueMonitor) and their labels
+QUEUE_COLUMNS = [
+    ('MacQueueMean', 'mac_queue', 'MAC queue (packets/node)'),
+    ('RouteBufferMean', 'route_buffer', 'Routing buffer (packets)'),
+]
+
+
+def queue_statistics(df):
+    """Queue occupancy summaries and their correlation with interval delay"""
+    stats = {}
+    for column, key, _ in QUEUE_COLUMNS:
+        if column not in df:
+            continue
+        stats[f'avg_{key}'] = df[column].mean()
+        stats[f'max_{key}'] = df[column.replace('Mean', 'Max')].max()
+        stats[f'delay_corr_{key}'] = df[column].corr(df['IntervalDelay'])
+    return stats
+
+
+def format_queue_statistics(stats):
+    lines = []
+    for _, key, label in QUEUE_COLUMNS:
+        if f'avg_{key}' not in stats:
+            continue
+        if not lines:
+            lines.append("  Queue Occupancy:")
+        lines.append(f"    {label}: mean {stats[f'avg_{key}']:.2f}, max {stats[f'max_{key}']:.0f}, "
+                     f"r(interval delay) = {stats[f'delay_corr_{key}']:+.3f}")
+    return lines
+
+
+def run_statistics(df):
+    """Summary statistics over the interval rows of one run"""
+    return {
+        **queue_statistics(df),
+        'avg_throughput': df['ThroughputKbps'].mean(),
+        'max_throughput': df['ThroughputKbps'].max(),
+        'min_throughput': df['ThroughputKbps'].min(),
+        'std_throughput': df['ThroughputKbps'].std(),
+
+        'avg_pdr': df['PDR'].mean(),
+        'min_pdr': df['PDR'].min(),
+        'max_pdr': df['PDR'].max(),
+        'std_pdr': df['PDR'].std(),
+
+        'avg_delay': df['AvgDelay'].mean(),
+        'min_delay': df['AvgDelay'].min(),
+        'max_delay': df['AvgDelay'].max(),
+        'std_delay': df['AvgDelay'].std(),
+
+        'final_pdr': df['PDR'].iloc[-1] if len(df) > 0 else float('nan'),
+        'final_delay': df['AvgDelay'].iloc[-1] if len(df) > 0 else float('nan'),
+        'total_overhead': df['RoutingOverhead'].iloc[-1] if len(df) > 0 else 0,
+        'avg_overhead_rate': df['RoutingOverhead'].diff().mean(),
+
+        'total_packets': df['PacketsReceived'].sum(),
+    }
+
+
+def compare_replications(records):
+    """Report lines comparing protocols with replications as the unit.
+
+    records: (scenario key, replication id, protocol, run statistics). Each
+    run contributes one value per metric; means get a Student-t 95% CI over
+    runs, and protocols are compared with paired t-tests on the replications
+    they share, Holm-adjusted per metric. In the ranking '>' separates
+    significantly different neighbours and '~' ties that are not.
+    """
+    scenarios = {}
+    for key, rep, protocol, stats in records:
+        scenarios.setdefault(key, {}).setdefault(protocol, {})[rep] = stats
+    varying = varying_parameters(scenarios)
+
+    lines = ["=" * 80, "REPLICATION ANALYSIS (one sample per run)", "=" * 80]
+    for index, (key, by_protocol) in enumerate(sorted(scenarios.items(), key=lambda s: str(s[0]))):
+        protocols = order_protocols(by_protocol)
+        reps = {r for runs in by_protocol.values() for r in runs}
+        lines += ["", f"Scenario {index + 1}: {scenario_label(key, varying)} "
+                      f"({len(reps)} replications)", "-" * 80]
+
+        for metric, label, higher in REPLICATION_METRICS:
+            samples = {p: np.array([s[metric] for s in by_protocol[p].values()], dtype=float)
+                       for p in protocols}
+            if not all(np.isfinite(v).all() for v in samples.values()):
+                # e.g. delay in runs with --delayMetrics=false
+                lines += [f"{label}: not recorded in every run", ""]
+                continue
+            means = {p: samples[p].mean() for p in protocols}
+            ranked = sorted(protocols, key=lambda p: -means[p] if higher else means[p])
+
+            lines.append(f"{label} ({'higher' if higher else 'lower'} is better)")
+            lines.append(f"  {'Rank':<6}{'Protocol':<10}{'n':<5}{'Mean':<14}95% CI")
+            for rank, p in enumerate(ranked, 1):
+                n = len(samples[p])
+                half = t95(n - 1) * samples[p].std(ddof=1) / math.sqrt(n) if n > 1 else float('nan')
+                ci = f"[{means[p] - half:.6g}, {means[p] + half:.6g}]" if n > 1 else "n/a (single run)"
+                lines.append(f"  {rank:<6}{p:<10}{n:<5}{means[p]:<14.6g}{ci}")
+
+            tests = []
+            for i, a in enumerate(ranked):
+                for b in ranked[i + 1:]:
+                    shared = sorted(set(by_protocol[a]) & set(by_protocol[b]))
+                    if len(shared) < 2:
+                        continue
+                    diff, p = paired_t_test([by_protocol[a][r][metric] for r in shared],
+                                            [by_protocol[b][r][metric] for r in shared])
+                    tests.append((a, b, len(shared), diff, p))
+
+            significant = set()
+            if tests:
+                lines.append("  Paired t-tests on shared seeds (Holm-adjusted p):")
+                for (a, b, n, diff, p), adj in zip(tests, holm([t[4] for t in tests])):
+                    mark = '*' if adj < SIGNIFICANCE else ''
+                    if mark:
+                        significant.add((a, b))
+                    lines.append(f"    {a + ' vs ' + b:<16} n={n:<4} diff={diff:<+12.6g} "
+                                 f"p={p:.4f}  adj={adj:.4f} {mark}")
+            else:
+                lines.append("  Paired t-tests: need at least 2 shared replications")
+
+            ranking = ranked[0]
+            for a, b in zip(ranked, ranked[1:]):
+                ranking += (' > ' if (a, b) in significant else ' ~ ') + b
+            lines.append(f"  Ranking: {ranking}")
+            lines.append("")
+    return lines
+
+
+def write_replication_report(lines, filename, append=False):
+    with open(filename, 'a' if append else 'w') as f:
+        if append:
+            f.write("\n")
+        f.write("\n".join(lines) + "\n")
+    print(f"\n✓ Replication analysis saved to {filename}")
+
+
+def lttb(x, y, threshold):
+    """Largest-Triangle-Three-Buckets downsampling to `threshold` points.
+
+    Keeps the first and last point and, per bucket, the point forming the
+    largest triangle with the previously kept point and the next bucket's
+    average, which preserves peaks and the overall shape of the series.
+    """
+    x = np.asarray(x, dtype=float)
+    y = np.asarray(y, dtype=float)
+    keep = lttb_indices(x, y, threshold)
+    return x[keep], y[keep]
+
+
+def lttb_indices(x, y, threshold):
+    """Indices of the points lttb() keeps, for decimating aligned columns"""
+    x = np.asarray(x, dtype=float)
+    y = np.asarray(y, dtype=float)
+    n = len(x)
+    if threshold >= n or threshold < 3:
+        return np.arange(n)
+
+    every = (n - 2) / (threshold - 2)
+    keep = np.empty(threshold, dtype=np.int64)
+    keep[0], keep[-1] = 0, n - 1
+    a = 0
+    for i in range(threshold - 2):
+        start = int(i * every) + 1
+        end = int((i + 1) * every) + 1
+        next_end = min(int((i + 2) * every) + 1, n)
+        avg_x = x[end:next_end].mean()
+        avg_y = y[end:next_end].mean()
+        area = np.abs((x[a] - avg_x) * (y[start:end] - y[a])
+                      - (x[a] - x[start:end]) * (avg_y - y[a]))
+        a = start + int(np.argmax(area))
+        keep[i + 1] = a
+    return keep
+
+
+def plot_time_series(data, protocols, output_dir, max_points=MAX_PLOT_POINTS):
+    """Line plots of every metric over time, decimated for rendering"""
+    fig, axes = plt.subplots(2, 2, figsize=(15, 10))
+    fig.suptitle('MANET Routing Protocol Performance Comparison', fontsize=16, fontweight='bold')
+
+    # Throughput
+    ax = axes[0, 0]
+    for protocol in protocols:
+        df = data[protocol]
+        ax.plot(*lttb(df['Time'], df['ThroughputKbps'], max_points),
+               label=protocol, color=COLORS.get(protocol, 'gray'), linewidth=2)
+    ax.set_xlabel('Time (seconds)')
+    ax.set_ylabel('Throughput (Kbps)')
+    ax.set_title('Throughput Over Time')
+    ax.legend()
+    ax.grid(True, alpha=0.3)
+
+    # PDR
+    ax = axes[0, 1]
+    for protocol in protocols:
+        df = data[protocol]
+        ax.plot(*lttb(df['Time'], df['PDR'], max_points),
+               label=protocol, color=COLORS.get(protocol, 'gray'), linewidth=2)
+    ax.set_xlabel('Time (seconds)')
+    ax.set_ylabel('PDR')
+    ax.set_title('Packet Delivery Ratio Over Time')
+    ax.set_ylim([0, 1.1])
+    ax.legend()
+    ax.grid(True, alpha=0.3)
+
+    # Delay
+    ax = axes[1, 0]
+    for protocol in protocols:
+        df = data[protocol]
+        ax.plot(*lttb(df['Time'], df['AvgDelay'], max_points),
+               label=protocol, color=COLORS.get(protocol, 'gray'), linewidth=2)
+    ax.set_xlabel('Time (seconds)')
+    ax.set_ylabel('Average Delay (seconds)')
+    ax.set_title('End-to-End Delay Over Time')
+    ax.legend()
+    ax.grid(True, alpha=0.3)
+
+    # Routing Overhead
+    ax = axes[1, 1]
+    for protocol in protocols:
+        df = data[protocol]
+        ax.plot(*lttb(df['Time'], df['RoutingOverhead'], max_points),
+               label=protocol, color=COLORS.get(protocol, 'gray'), linewidth=2)
+    ax.set_xlabel('Time (seconds)')
+    ax.set_ylabel('Cumulative Routing Packets')
+    ax.set_title('Routing Overhead Over Time')
+    ax.legend()
+    ax.grid(True, alpha=0.3)
+
+    plt.tight_layout()
+    plt.savefig(f'{output_dir}/time_series_comparison.png', dpi=300, bbox_inches='tight')
+    plt.close()
+    return f'{output_dir}/time_series_comparison.png'
+
+
+def plot_average_performance(stats, protocols, output_dir):
+    """Bar charts of the per-protocol averages"""
+    fig, axes = plt.subplots(2, 2, figsize=(14, 10))
+    fig.suptitle('Average Performance Metrics Comparison', fontsize=16, fontweight='bold')
+
+    protocols_list = list(protocols)
+    x_pos = np.arange(len(protocols_list))
+
+    # Average Throughput
+    ax = axes[0, 0]
+    values = [stats[p]['avg_throughput'] for p in protocols_list]
+    bars = ax.bar(x_pos, values, color=[COLORS.get(p, 'gray') for p in protocols_list])
+    ax.set_xlabel('Protocol')
+    ax.set_ylabel('Throughput (Kbps)')
+    ax.set_title('Average Throughput')
+    ax.set_xticks(x_pos)
+    ax.set_xticklabels(protocols_list)
+    ax.grid(True, alpha=0.3, axis='y')
+
+    # Add value labels on bars
+    for i, bar in enumerate(bars):
+        height = bar.get_height()
+        ax.text(bar.get_x() + bar.get_width()/2., height,
+               f'{height:.1f}', ha='center', va='bottom')
+
+    # Average PDR
+    ax = axes[0, 1]
+    values = [stats[p]['avg_pdr'] for p in protocols_list]
+    bars = ax.bar(x_pos, values, color=[COLORS.get(p, 'gray') for p in protocols_list])
+    ax.set_xlabel('Protocol')
+    ax.set_ylabel('PDR')
+    ax.set_title('Average Packet Delivery Ratio')
+    ax.set_xticks(x_pos)
+    ax.set_xticklabels(protocols_list)
+    ax.set_ylim([0, 1.1])
+    ax.grid(True, alpha=0.3, axis='y')
+
+    for i, bar in enumerate(bars):
+        height = bar.get_height()
+        ax.text(bar.get_x() + bar.get_width()/2., height,
+               f'{height:.3f}', ha='center', va='bottom')
+
+    # Average Delay
+    ax = axes[1, 0]
+    values = [stats[p]['avg_delay'] for p in protocols_list]
+    bars = ax.bar(x_pos, values, color=[COLORS.get(p, 'gray') for p in protocols_list])
+    ax.set_xlabel('Protocol')
+    ax.set_ylabel('Delay (seconds)')
+    ax.set_title('Average End-to-End Delay')
+    ax.set_xticks(x_pos)
+    ax.set_xticklabels(protocols_list)
+    ax.grid(True, alpha=0.3, axis='y')
+
+    for i, bar in enumerate(bars):
+        height = bar.get_height()
+        if not np.isfinite(height):
+            continue
+        ax.text(bar.get_x() + bar.get_width()/2., height,
+               f'{height:.4f}', ha='center', va='bottom')
+
+    # Total Routing Overhead
+    ax = axes[1, 1]
+    values = [stats[p]['total_overhead'] for p in protocols_list]
+    bars = ax.bar(x_pos, values, color=[COLORS.get(p, 'gray') for p in protocols_list])
+    ax.set_xlabel('Protocol')
+    ax.set_ylabel('Total Routing Packets')
+    ax.set_title('Total Routing Overhead')
+    ax.set_xticks(x_pos)
+    ax.set_xticklabels(protocols_list)
+    ax.grid(True, alpha=0.3, axis='y')
+
+    for i, bar in enumerate(bars):
+        height = bar.get_height()
+        ax.text(bar.get_x() + bar.get_width()/2., height,
+               f'{height:.0f}', ha='center', va='bottom')
+
+    plt.tight_layout()
+    plt.savefig(f'{output_dir}/average_performance.png', dpi=300, bbox_inches='tight')
+    plt.close()
+    return f'{output_dir}/average_performance.png'
+
+
+def plot_distributions(data, protocols, output_dir):
+    """Box plots of the per-interval metric distributions"""
+    protocols_list = list(protocols)
+
+    fig, axes = plt.subplots(2, 2, figsize=(14, 10))
+    fig.suptitle('Performance Distribution Analysis', fontsize=16, fontweight='bold')
+
+    # Throughput distribution
+    ax = axes[0, 0]
+    data_to_plot = [data[p]['ThroughputKbps'].values for p in protocols_list]
+    bp = ax.boxplot(data_to_plot, labels=protocols_list, patch_artist=True)
+    for patch, protocol in zip(bp['boxes'], protocols_list):
+        patch.set_facecolor(COLORS.get(protocol, 'gray'))
+    ax.set_ylabel('Throughput (Kbps)')
+    ax.set_title('Throughput Distribution')
+    ax.grid(True, alpha=0.3, axis='y')
+
+    # PDR distribution
+    ax = axes[0, 1]
+    data_to_plot = [data[p]['PDR'].values for p in protocols_list]
+    bp = ax.boxplot(data_to_plot, labels=protocols_list, patch_artist=True)
+    for patch, protocol in zip(bp['boxes'], protocols_list):
+        patch.set_facecolor(COLORS.get(protocol, 'gray'))
+    ax.set_ylabel('PDR')
+    ax.set_title('PDR Distribution')
+    ax.grid(True, alpha=0.3, axis='y')
+
+    # Delay distribution
+    ax = axes[1, 0]
+    data_to_plot = [data[p]['AvgDelay'].dropna().values for p in protocols_list]
+    bp = ax.boxplot(data_to_plot, labels=protocols_list, patch_artist=True)
+    for patch, protocol in zip(bp['boxes'], protocols_list):
+        patch.set_facecolor(COLORS.get(protocol, 'gray'))
+    ax.set_ylabel('Delay (seconds)')
+    ax.set_title('Delay Distribution')
+    ax.grid(True, alpha=0.3, axis='y')
+
+    # Remove empty subplot
+    fig.delaxes(axes[1, 1])
+
+    plt.tight_layout()
+    plt.savefig(f'{output_dir}/distribution_analysis.png', dpi=300, bbox_inches='tight')
+    plt.close()
+    return f'{output_dir}/distribution_analysis.png'
+
+
+def plot_correlation(data, protocols, output_dir):
+    """Heatmaps of metric correlations per protocol"""
+    protocols_list = list(protocols)
+
+    fig, axes = plt.subplots(1, len(protocols_list), figsize=(16, 4))
+    if len(protocols_list) == 1:
+        axes = [axes]
+
+    fig.suptitle('Metric Correlation Analysis', fontsize=16, fontweight='bold')
+
+    for idx, protocol in enumerate(protocols_list):
+        df = data[protocol]
+        corr_cols = ['ThroughputKbps', 'PDR', 'AvgDelay', 'RoutingOverhead']
+        corr_matrix = df[corr_cols].corr()
+
+        sns.heatmap(corr_matrix, annot=True, fmt='.2f', cmap='coolwarm', 
+                   center=0, square=True, ax=axes[idx], cbar_kws={'shrink': 0.8})
+        axes[idx].set_title(f'{protocol}')
+
+    plt.tight_layout()
+    plt.savefig(f'{output_dir}/correlation_heatmap.png', dpi=300, bbox_inches='tight')
+    plt.close()
+    return f'{output_dir}/correlation_heatmap.png'
+
+
+# (file name, plot function, takes statistics rather than frames)
+FIGURES = [
+    ('time_series_comparison.png', plot_time_series, False),
+    ('average_performance.png', plot_average_performance, True),
+    ('distribution_analysis.png', plot_distributions, False),
+    ('correlation_heatmap.png', plot_correlation, False),
+]
+
+
 class MANETAnalyzer:
-    def __init__(self, protocols=['AODV', 'OLSR', 'DSR', 'DSDV']):
-        self.protocols = protocols
+    def __init__(self, protocols=None, run_dir='.', cache=None):
+        self.protocols = list(protocols) if protocols else list(DEFAULT_PROTOCOLS)
+        self.run_dir = Path(run_dir)
+        self.cache = cache
+        self.inputs = {}
+        self.hashes = {}
         self.data = {}
         self.stats = {}
-        
-    def load_data(self):
-        """Load CSV files for all protocols"""
-        print("Loading data files...")
+
+    def set_inputs(self, outputs):
+        """Select the protocol CSVs to analyze and hash them for the cache"""
         for protocol in self.protocols:
-            filename = f"{protocol}-OUTPUT.csv"
-            try:
-                df = pd.read_csv(filename)
-                self.data[protocol] = df
-                print(f"✓ Loaded {filename}: {len(df)} rows")
-            except FileNotFoundError:
-                print(f"✗ Warning: {filename} not found")
-                self.protocols.remove(protocol)
-        
-        if not self.data:
+            if protocol in outputs:
+                continue
+            if any((self.run_dir / f"{protocol}{SCREEN_TAG}{s}").exists() for s in OUTPUT_SUFFIXES):
+                print(f"✗ {protocol} was pruned by screening and is left out")
+            else:
+                print(f"✗ Warning: {protocol}-OUTPUT.csv not found")
+        self.inputs = {p: outputs[p] for p in self.protocols if p in outputs}
+        self.protocols = list(self.inputs)
+        if self.cache is not None:
+            self.hashes = {p: self.cache.file_hash(path) for p, path in self.inputs.items()}
+
+        if not self.inputs:
             print("Error: No data files found!")
             sys.exit(1)
+
+    def summary_key(self, protocol):
+        return ArtifactCache.key('summary', self.hashes[protocol])
+
+    def figure_key(self, name):
+        inputs = tuple((p, self.hashes[p]) for p in self.protocols)
+        return ArtifactCache.key('figure', name, MAX_PLOT_POINTS, inputs)
+
+    def needed_frames(self):
+        """Protocols whose CSV has to be parsed for this analysis.
+
+        Without a cache that is all of them. With one, a missing figure
+        needs every frame of the run, otherwise only protocols without a
+        cached summary are parsed.
+        """
+        if self.cache is None or any(not self.cache.has(self.figure_key(name), '.png')
+                                     for name, _, _ in FIGURES):
+            return list(self.protocols)
+        return [p for p in self.protocols if not self.cache.has(self.summary_key(p), '.pkl')]
+
+    def load_data(self, frames=None, workers=None, cache_dir=CACHE_DIR):
+        """Load the CSVs this analysis needs (or take pre-loaded frames)"""
+        print("Loading data files...")
+        if not self.inputs:
+            self.set_inputs(find_outputs(self.run_dir))
+        if frames is None:
+            wanted = self.needed_frames()
+            frames = dict(zip(wanted, load_frames([self.inputs[p] for p in wanted],
+                                                  workers, cache_dir)))
+
+        self.data = {p: frames[p] for p in self.protocols if p in frames}
+        for protocol in self.protocols:
+            if protocol in self.data:
+                print(f"✓ Loaded {protocol}: {len(self.data[protocol])} rows")
+            else:
+                print(f"✓ {protocol}: unchanged, using cached results")
     
     def calculate_statistics(self):
         """Calculate comprehensive statistics for each protocol"""
         print("\nCalculating statistics...")
         
         for protocol in self.protocols:
-            df = self.data[protocol]
-            
-            # Calculate metrics
-            stats = {
-                'avg_throughput': df['ThroughputKbps'].mean(),
-                'max_throughput': df['ThroughputKbps'].max(),
-                'min_throughput': df['ThroughputKbps'].min(),
-                'std_throughput': df['ThroughputKbps'].std(),
-                
-                'avg_pdr': df['PDR'].mean(),
-                'min_pdr': df['PDR'].min(),
-                'max_pdr': df['PDR'].max(),
-                'std_pdr': df['PDR'].std(),
-                
-                'avg_delay': df['AvgDelay'].mean(),
-                'min_delay': df['AvgDelay'].min(),
-                'max_delay': df['AvgDelay'].max(),
-                'std_delay': df['AvgDelay'].std(),
-                
-                'total_overhead': df['RoutingOverhead'].iloc[-1] if len(df) > 0 else 0,
-                'avg_overhead_rate': df['RoutingOverhead'].diff().mean(),
-                
-                'total_packets': df['PacketsReceived'].sum(),
-            }
-            
+            stats = None
+            if self.cache is not None:
+                stats = self.cache.get_summary(self.summary_key(protocol))
+            if stats is None:
+                stats = run_statistics(self.data[protocol])
+                if self.cache is not None:
+                    self.cache.put_summary(self.summary_key(protocol), stats)
+                print(f"✓ Calculated statistics for {protocol}")
+            else:
+                print(f"✓ Reused cached statistics for {protocol}")
             self.stats[protocol] = stats
-            print(f"✓ Calculated statistics for {protocol}")
     
     def print_summary(self):
         """Print summary statistics"""
@@ -113,217 +844,57 @@ class MANETAnalyzer:
             print(f"  Routing Overhead:")
             print(f"    Total packets: {stats['total_overhead']:.0f}")
             print(f"    Average rate: {stats['avg_overhead_rate']:.2f} packets/sec")
+            for line in format_queue_statistics(stats):
+                print(line)
     
-    def generate_plots(self, output_dir='plots'):
-        """Generate comprehensive comparison plots"""
+    def generate_plots(self, output_dir='plots', executor=None):
+        """Generate comprehensive comparison plots
+
+        Each figure is rendered in its own worker process. When an executor
+        is passed the futures are returned without waiting, so figures of
+        several runs can render concurrently; otherwise this blocks until
+        all figures are saved. Figures whose inputs are unchanged are copied
+        from the cache instead of being rendered.
+        """
         Path(output_dir).mkdir(exist_ok=True)
         print(f"\nGenerating plots in '{output_dir}/' directory...")
-        
-        # Color palette
-        colors = {'AODV': '#e41a1c', 'OLSR': '#377eb8', 
-                  'DSR': '#4daf4a', 'DSDV': '#984ea3'}
-        
-        # 1. Time Series Plots
-        fig, axes = plt.subplots(2, 2, figsize=(15, 10))
-        fig.suptitle('MANET Routing Protocol Performance Comparison', fontsize=16, fontweight='bold')
-        
-        # Throughput
-        ax = axes[0, 0]
-        for protocol in self.protocols:
-            df = self.data[protocol]
-            ax.plot(df['Time'], df['ThroughputKbps'], 
-                   label=protocol, color=colors.get(protocol, 'gray'), linewidth=2)
-        ax.set_xlabel('Time (seconds)')
-        ax.set_ylabel('Throughput (Kbps)')
-        ax.set_title('Throughput Over Time')
-        ax.legend()
-        ax.grid(True, alpha=0.3)
-        
-        # PDR
-        ax = axes[0, 1]
-        for protocol in self.protocols:
-            df = self.data[protocol]
-            ax.plot(df['Time'], df['PDR'], 
-                   label=protocol, color=colors.get(protocol, 'gray'), linewidth=2)
-        ax.set_xlabel('Time (seconds)')
-        ax.set_ylabel('PDR')
-        ax.set_title('Packet Delivery Ratio Over Time')
-        ax.set_ylim([0, 1.1])
-        ax.legend()
-        ax.grid(True, alpha=0.3)
-        
-        # Delay
-        ax = axes[1, 0]
-        for protocol in self.protocols:
-            df = self.data[protocol]
-            ax.plot(df['Time'], df['AvgDelay'], 
-                   label=protocol, color=colors.get(protocol, 'gray'), linewidth=2)
-        ax.set_xlabel('Time (seconds)')
-        ax.set_ylabel('Average Delay (seconds)')
-        ax.set_title('End-to-End Delay Over Time')
-        ax.legend()
-        ax.grid(True, alpha=0.3)
-        
-        # Routing Overhead
-        ax = axes[1, 1]
-        for protocol in self.protocols:
-            df = self.data[protocol]
-            ax.plot(df['Time'], df['RoutingOverhead'], 
-                   label=protocol, color=colors.get(protocol, 'gray'), linewidth=2)
-        ax.set_xlabel('Time (seconds)')
-        ax.set_ylabel('Cumulative Routing Packets')
-        ax.set_title('Routing Overhead Over Time')
-        ax.legend()
-        ax.grid(True, alpha=0.3)
-        
-        plt.tight_layout()
-        plt.savefig(f'{output_dir}/time_series_comparison.png', dpi=300, bbox_inches='tight')
-        print(f"✓ Saved: {output_dir}/time_series_comparison.png")
-        plt.close()
-        
-        # 2. Bar Charts for Average Performance
-        fig, axes = plt.subplots(2, 2, figsize=(14, 10))
-        fig.suptitle('Average Performance Metrics Comparison', fontsize=16, fontweight='bold')
-        
-        protocols_list = list(self.protocols)
-        x_pos = np.arange(len(protocols_list))
-        
-        # Average Throughput
-        ax = axes[0, 0]
-        values = [self.stats[p]['avg_throughput'] for p in protocols_list]
-        bars = ax.bar(x_pos, values, color=[colors.get(p, 'gray') for p in protocols_list])
-        ax.set_xlabel('Protocol')
-        ax.set_ylabel('Throughput (Kbps)')
-        ax.set_title('Average Throughput')
-        ax.set_xticks(x_pos)
-        ax.set_xticklabels(protocols_list)
-        ax.grid(True, alpha=0.3, axis='y')
-        
-        # Add value labels on bars
-        for i, bar in enumerate(bars):
-            height = bar.get_height()
-            ax.text(bar.get_x() + bar.get_width()/2., height,
-                   f'{height:.1f}', ha='center', va='bottom')
-        
-        # Average PDR
-        ax = axes[0, 1]
-        values = [self.stats[p]['avg_pdr'] for p in protocols_list]
-        bars = ax.bar(x_pos, values, color=[colors.get(p, 'gray') for p in protocols_list])
-        ax.set_xlabel('Protocol')
-        ax.set_ylabel('PDR')
-        ax.set_title('Average Packet Delivery Ratio')
-        ax.set_xticks(x_pos)
-        ax.set_xticklabels(protocols_list)
-        ax.set_ylim([0, 1.1])
-        ax.grid(True, alpha=0.3, axis='y')
-        
-        for i, bar in enumerate(bars):
-            height = bar.get_height()
-            ax.text(bar.get_x() + bar.get_width()/2., height,
-                   f'{height:.3f}', ha='center', va='bottom')
-        
-        # Average Delay
-        ax = axes[1, 0]
-        values = [self.stats[p]['avg_delay'] for p in protocols_list]
-        bars = ax.bar(x_pos, values, color=[colors.get(p, 'gray') for p in protocols_list])
-        ax.set_xlabel('Protocol')
-        ax.set_ylabel('Delay (seconds)')
-        ax.set_title('Average End-to-End Delay')
-        ax.set_xticks(x_pos)
-        ax.set_xticklabels(protocols_list)
-        ax.grid(True, alpha=0.3, axis='y')
-        
-        for i, bar in enumerate(bars):
-            height = bar.get_height()
-            ax.text(bar.get_x() + bar.get_width()/2., height,
-                   f'{height:.4f}', ha='center', va='bottom')
-        
-        # Total Routing Overhead
-        ax = axes[1, 1]
-        values = [self.stats[p]['total_overhead'] for p in protocols_list]
-        bars = ax.bar(x_pos, values, color=[colors.get(p, 'gray') for p in protocols_list])
-        ax.set_xlabel('Protocol')
-        ax.set_ylabel('Total Routing Packets')
-        ax.set_title('Total Routing Overhead')
-        ax.set_xticks(x_pos)
-        ax.set_xticklabels(protocols_list)
-        ax.grid(True, alpha=0.3, axis='y')
-        
-        for i, bar in enumerate(bars):
-            height = bar.get_height()
-            ax.text(bar.get_x() + bar.get_width()/2., height,
-                   f'{height:.0f}', ha='center', va='bottom')
-        
-        plt.tight_layout()
-        plt.savefig(f'{output_dir}/average_performance.png', dpi=300, bbox_inches='tight')
-        print(f"✓ Saved: {output_dir}/average_performance.png")
-        plt.close()
-        
-        # 3. Box Plots for Distribution Analysis
-        fig, axes = plt.subplots(2, 2, figsize=(14, 10))
-        fig.suptitle('Performance Distribution Analysis', fontsize=16, fontweight='bold')
-        
-        # Throughput distribution
-        ax = axes[0, 0]
-        data_to_plot = [self.data[p]['ThroughputKbps'].values for p in protocols_list]
-        bp = ax.boxplot(data_to_plot, labels=protocols_list, patch_artist=True)
-        for patch, protocol in zip(bp['boxes'], protocols_list):
-            patch.set_facecolor(colors.get(protocol, 'gray'))
-        ax.set_ylabel('Throughput (Kbps)')
-        ax.set_title('Throughput Distribution')
-        ax.grid(True, alpha=0.3, axis='y')
-        
-        # PDR distribution
-        ax = axes[0, 1]
-        data_to_plot = [self.data[p]['PDR'].values for p in protocols_list]
-        bp = ax.boxplot(data_to_plot, labels=protocols_list, patch_artist=True)
-        for patch, protocol in zip(bp['boxes'], protocols_list):
-            patch.set_facecolor(colors.get(protocol, 'gray'))
-        ax.set_ylabel('PDR')
-        ax.set_title('PDR Distribution')
-        ax.grid(True, alpha=0.3, axis='y')
-        
-        # Delay distribution
-        ax = axes[1, 0]
-        data_to_plot = [self.data[p]['AvgDelay'].values for p in protocols_list]
-        bp = ax.boxplot(data_to_plot, labels=protocols_list, patch_artist=True)
-        for patch, protocol in zip(bp['boxes'], protocols_list):
-            patch.set_facecolor(colors.get(protocol, 'gray'))
-        ax.set_ylabel('Delay (seconds)')
-        ax.set_title('Delay Distribution')
-        ax.grid(True, alpha=0.3, axis='y')
-        
-        # Remove empty subplot
-        fig.delaxes(axes[1, 1])
-        
-        plt.tight_layout()
-        plt.savefig(f'{output_dir}/distribution_analysis.png', dpi=300, bbox_inches='tight')
-        print(f"✓ Saved: {output_dir}/distribution_analysis.png")
-        plt.close()
-        
-        # 4. Correlation Heatmap
-        fig, axes = plt.subplots(1, len(protocols_list), figsize=(16, 4))
-        if len(protocols_list) == 1:
-            axes = [axes]
-        
-        fig.suptitle('Metric Correlation Analysis', fontsize=16, fontweight='bold')
-        
-        for idx, protocol in enumerate(protocols_list):
-            df = self.data[protocol]
-            corr_cols = ['ThroughputKbps', 'PDR', 'AvgDelay', 'RoutingOverhead']
-            corr_matrix = df[corr_cols].corr()
-            
-            sns.heatmap(corr_matrix, annot=True, fmt='.2f', cmap='coolwarm', 
-                       center=0, square=True, ax=axes[idx], cbar_kws={'shrink': 0.8})
-            axes[idx].set_title(f'{protocol}')
-        
-        plt.tight_layout()
-        plt.savefig(f'{output_dir}/correlation_heatmap.png', dpi=300, bbox_inches='tight')
-        print(f"✓ Saved: {output_dir}/correlation_heatmap.png")
-        plt.close()
-        
+
+        pending = []
+        for name, plot, uses_stats in FIGURES:
+            if self.cache is not None and self.cache.fetch(self.figure_key(name), '.png',
+                                                           Path(output_dir) / name):
+                print(f"✓ Reused: {output_dir}/{name}")
+            else:
+                pending.append((name, plot, uses_stats))
+        if not pending:
+            return []
+
+        protocols = list(self.protocols)
+        data = {p: self.data[p][PLOT_COLUMNS] for p in protocols}
+        stats = {p: self.stats[p] for p in protocols}
+
+        own_executor = executor is None
+        if own_executor:
+            executor = ProcessPoolExecutor(max_workers=4)
+        futures = []
+        for name, plot, uses_stats in pending:
+            future = executor.submit(plot, stats if uses_stats else data, protocols, output_dir)
+            if self.cache is not None:
+                future.add_done_callback(partial(self._cache_figure, self.figure_key(name)))
+            futures.append(future)
+        if not own_executor:
+            return futures
+
+        for future in futures:
+            print(f"✓ Saved: {future.result()}")
+        executor.shutdown()
         print(f"\n✓ All plots generated successfully!")
+        return []
     
+    def _cache_figure(self, key, future):
+        if future.exception() is None:
+            self.cache.store(key, '.png', future.result())
+
     def save_statistics(self, filename='statistics_summary.txt'):
         """Save statistics to a text file"""
         with open(filename, 'w') as f:
@@ -367,32 +938,133 @@ class MANETAnalyzer:
                 f.write(f"  Routing Overhead:\n")
                 f.write(f"    Total packets: {stats['total_overhead']:.0f}\n")
                 f.write(f"    Average rate: {stats['avg_overhead_rate']:.2f} packets/sec\n")
+                for line in format_queue_statistics(stats):
+                    f.write(line + "\n")
         
         print(f"\n✓ Statistics saved to {filename}")
 
+def read_routing_snapshots(filename):
+    """Yield (time, node, table) from a <protocol>-RTSNAP.bin[.gz] file.
+
+    The file stores delta-encoded per-node routing tables (see
+    RoutingSnapshotWriter in routing-analysis.cc); each yielded table is the
+    full reconstructed table, a dict mapping destination address to
+    (next_hop, hops, seq_no, expiry_ms). Addresses are dotted quads.
+    """
+    opener = gzip.open if str(filename).endswith('.gz') else open
+    with opener(filename, 'rb') as f:
+        magic, version, _, n_nodes = struct.unpack('=4sHHI', f.read(12))
+        if magic != b'MRTS' or version != 1:
+            raise ValueError(f"{filename}: not a routing snapshot file")
+
+        def addr(value):
+            return '.'.join(str((value >> shift) & 0xff) for shift in (24, 16, 8, 0))
+
+        tables = [dict() for _ in range(n_nodes)]
+        entry = struct.Struct('=IIHIi')
+        while True:
+            header = f.read(16)
+            if len(header) < 16:
+                break
+            time, node, n_changed, n_removed = struct.unpack('=dIHH', header)
+            table = tables[node]
+            for _ in range(n_changed):
+                dest, next_hop, hops, seq_no, expiry = entry.unpack(f.read(entry.size))
+                table[addr(dest)] = (addr(next_hop), hops, seq_no, expiry)
+            for dest in struct.unpack(f'={n_removed}I', f.read(4 * n_removed)):
+                table.pop(addr(dest), None)
+            yield time, node, dict(table)
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description="Analyze MANET routing simulation output")
+    parser.add_argument('--results', metavar='DIR',
+                        help="analyze every run directory found under DIR "
+                             "(default: the CSVs in the current directory)")
+    parser.add_argument('--workers', type=int, default=None,
+                        help="worker processes for loading and plotting (default: CPU count)")
+    parser.add_argument('--no-cache', action='store_true',
+                        help="recompute everything instead of using the frame, "
+                             "summary and figure caches")
+    return parser.parse_args()
+
+
+def analyze(analyzer, output_dir='.', executor=None):
+    """Run the full analysis pipeline for one run directory
+
+    Returns the pending plot futures when a shared executor is given.
+    """
+    output_dir = Path(output_dir)
+    analyzer.calculate_statistics()
+    analyzer.print_summary()
+    futures = analyzer.generate_plots(output_dir / 'plots', executor)
+    analyzer.save_statistics(output_dir / 'statistics_summary.txt')
+    return futures
+
+
 def main():
+    args = parse_args()
+    cache_dir = None if args.no_cache else CACHE_DIR
+    cache = None if args.no_cache else ArtifactCache(CACHE_DIR)
+
     print("="*80)
     print("MANET Routing Protocol Performance Analyzer")
     print("="*80)
     
-    # Create analyzer
-    analyzer = MANETAnalyzer()
-    
-    # Load data
-    analyzer.load_data()
-    
-    # Calculate statistics
-    analyzer.calculate_statistics()
-    
-    # Print summary
-    analyzer.print_summary()
-    
-    # Generate plots
-    analyzer.generate_plots()
-    
-    # Save statistics
-    analyzer.save_statistics()
+    if args.results is None:
+        analyzer = MANETAnalyzer(cache=cache)
+        analyzer.load_data(workers=args.workers, cache_dir=cache_dir)
+        analyze(analyzer)
+    else:
+        runs = discover_runs(args.results)
+        if not runs:
+            print(f"Error: No run directories found under {args.results}!")
+            sys.exit(1)
+
+        analyzers = []
+        for run_dir, outputs in runs:
+            analyzer = MANETAnalyzer(order_protocols(outputs), run_dir, cache)
+            analyzer.set_inputs(outputs)
+            analyzers.append(analyzer)
+
+        # Parse every CSV that is not covered by the cache in one parallel batch
+        jobs = [(i, protocol, analyzer.inputs[protocol]) for i, analyzer in enumerate(analyzers)
+                for protocol in analyzer.needed_frames()]
+        print(f"Loading {len(jobs)} files from {len(runs)} runs...")
+        frames = load_frames([path for _, _, path in jobs], args.workers, cache_dir)
+        per_run = [dict() for _ in runs]
+        for (i, protocol, _), df in zip(jobs, frames):
+            per_run[i][protocol] = df
+
+        # Figures of all runs share one pool so rendering overlaps across runs
+        records = []
+        with ProcessPoolExecutor(max_workers=args.workers) as executor:
+            futures = []
+            for analyzer, run_frames in zip(analyzers, per_run):
+                run_dir = analyzer.run_dir
+                print("\n" + "="*80)
+                print(f"Run: {run_dir}")
+                analyzer.load_data(frames=run_frames)
+                futures += analyze(analyzer, run_dir, executor)
+                for protocol in analyzer.protocols:
+                    records.append((*replication_id(run_dir, protocol), protocol,
+                                    analyzer.stats[protocol]))
+
+            # Across-run comparison goes next to the runs; if the results
+            # root is itself a run it extends that run's summary
+            lines = compare_replications(records)
+            print("\n" + "\n".join(lines))
+            root = Path(args.results)
+            write_replication_report(lines, root / 'statistics_summary.txt',
+                                     append=any(d.resolve() == root.resolve() for d, _ in runs))
+
+            print(f"\nRendering {len(futures)} figures...")
+            for future in futures:
+                print(f"✓ Saved: {future.result()}")
     
+    if cache is not None:
+        cache.save_index()
+
     print("\n" + "="*80)
     print("Analysis Complete!")
     print("="*80)
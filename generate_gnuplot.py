@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""
+MANET Sweep Plot Generator
+Builds gnuplot scripts and pre-aggregated data files from the run manifests
+(<protocol>-SUMMARY.json) found under a results tree
+"""
+
+import argparse
+import json
+import re
+import sys
+from pathlib import Path
+
+import numpy as np
+import pandas as pd
+
+from analyze_results import (COLORS, MAX_PLOT_POINTS, load_frame, lttb_indices, order_protocols,
+                             scenario_key, scenario_label, t95, varying_parameters)
+
+# (CSV column, panel title, y label)
+METRICS = [
+    ('ThroughputKbps', 'Throughput Over Time', 'Throughput (Kbps)'),
+    ('PDR', 'Packet Delivery Ratio (PDR) Over Time', 'PDR'),
+    ('AvgDelay', 'Average End-to-End Delay', 'Delay (seconds)'),
+    ('RoutingOverhead', 'Cumulative Routing Overhead', 'Routing Packets'),
+    ('PacketsReceived', 'Cumulative Packets Received', 'Packets Received'),
+]
+
+
+def load_manifests(root):
+    """Yield (manifest, csv_path) for every run summary under root"""
+    for path in sorted(Path(root).rglob('*-SUMMARY.json')):
+        with open(path) as f:
+            manifest = json.load(f)
+        if manifest['parameters'].get('fidelity') == 'screen':
+            continue
+        if 'csv' not in manifest['outputs']:
+            print(f"✗ Warning: {path} lists no CSV output")
+            continue
+        csv = path.parent / Path(manifest['outputs']['csv']).name
+        if not csv.exists():
+            print(f"✗ Warning: {csv} listed in {path} not found")
+            continue
+        yield manifest, csv
+
+
+def aggregate(frames, max_points):
+    """Mean and 95% CI per time step across replications, then decimated"""
+    times = sorted(set.intersection(*(set(df['Time']) for df in frames)))
+    aligned = [df.set_index('Time').loc[times] for df in frames]
+    n = len(aligned)
+
+    out = pd.DataFrame({'Time': times})
+    for column, _, _ in METRICS:
+        values = np.vstack([df[column].to_numpy(dtype=float) for df in aligned])
+        mean = values.mean(axis=0)
+        half = (t95(n - 1) * values.std(axis=0, ddof=1) / np.sqrt(n)) if n > 1 else np.zeros_like(mean)
+        out[f'{column}_mean'] = mean
+        out[f'{column}_lo'] = mean - half
+        out[f'{column}_hi'] = mean + half
+
+    # Keep the time steps LTTB selects on the throughput mean for every column
+    keep = lttb_indices(out['Time'], out['ThroughputKbps_mean'], max_points)
+    return out.iloc[keep], n
+
+
+def write_script(script_path, pages, protocols, style_ids):
+    """pages: list of (title, {protocol: (data_file, replications)})"""
+    lines = [
+        '# Generated by generate_gnuplot.py - do not edit by hand',
+        'set terminal pdfcairo enhanced font "Arial,10" size 10,12',
+        f'set output "{script_path.with_suffix(".pdf").name}"',
+        'set grid',
+        'set style fill transparent solid 0.20 noborder',
+        '',
+    ]
+    for protocol in protocols:
+        color = COLORS.get(protocol, '#808080')
+        lines.append(f"set style line {style_ids[protocol]} lc rgb '{color}' lt 1 lw 2")
+    lines.append('')
+
+    for title, series in pages:
+        lines.append(f'set multiplot layout 3,2 title "{title}" font ",14"')
+        for column, panel, ylabel in METRICS:
+            col = 2 + 3 * [m[0] for m in METRICS].index(column)
+            lines += [
+                f'set title "{panel}"',
+                'set xlabel "Time (seconds)"',
+                f'set ylabel "{ylabel}"',
+                'set key top left',
+            ]
+            plots = []
+            for protocol, (data_file, reps) in series.items():
+                ls = style_ids[protocol]
+                if reps > 1:
+                    plots.append(f'"{data_file}" using 1:{col + 1}:{col + 2} '
+                                 f'with filledcurves ls {ls} notitle')
+                label = f'{protocol} (n={reps})' if reps > 1 else protocol
+                plots.append(f'"{data_file}" using 1:{col} with lines ls {ls} title "{label}"')
+            lines.append('plot ' + ', \\\n     '.join(plots))
+            lines.append('')
+        lines.append('unset multiplot')
+        lines.append('')
+
+    script_path.write_text('\n'.join(lines))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate gnuplot scripts for a results tree")
+    parser.add_argument('results', help="directory searched for *-SUMMARY.json run manifests")
+    parser.add_argument('--output', default='sweep-plots',
+                        help="directory for the script and data files (default: sweep-plots)")
+    parser.add_argument('--max-points', type=int, default=MAX_PLOT_POINTS,
+                        help="points per line after downsampling")
+    args = parser.parse_args()
+
+    # scenario -> protocol -> list of frames (one per replication)
+    scenarios = {}
+    for manifest, csv in load_manifests(args.results):
+        key = scenario_key(manifest['parameters'])
+        protocol = manifest['parameters']['protocol']
+        scenarios.setdefault(key, {}).setdefault(protocol, []).append(load_frame(csv))
+
+    if not scenarios:
+        print(f"Error: No run manifests found under {args.results}!")
+        sys.exit(1)
+
+    varying = varying_parameters(scenarios)
+    protocols = order_protocols({p for s in scenarios.values() for p in s})
+    style_ids = {p: i + 1 for i, p in enumerate(protocols)}
+
+    output = Path(args.output)
+    (output / 'data').mkdir(parents=True, exist_ok=True)
+
+    pages = []
+    for index, (key, by_protocol) in enumerate(sorted(scenarios.items())):
+        title = scenario_label(key, varying)
+        series = {}
+        for protocol in protocols:
+            if protocol not in by_protocol:
+                continue
+            agg, reps = aggregate(by_protocol[protocol], args.max_points)
+            data_file = Path('data') / f"scenario{index + 1}_{re.sub(r'[^A-Za-z0-9]+', '_', protocol)}.dat"
+            agg.to_csv(output / data_file, sep=' ', index=False, header=False, float_format='%.6g')
+            series[protocol] = (data_file.as_posix(), reps)
+        pages.append((title, series))
+        print(f"✓ Scenario {index + 1}: {title} "
+              f"({', '.join(f'{p} x{r}' for p, (_, r) in series.items())})")
+
+    script = output / 'sweep.gnuplot'
+    write_script(script, pages, protocols, style_ids)
+    print(f"\n✓ Wrote {script}; render with: (cd {output} && gnuplot {script.name})")
+
+
+if __name__ == "__main__":
+    main()
@@ -12,55 +12,2415 @@
 #include "ns3/mobility-module.h"
 #include "ns3/network-module.h"
 #include "ns3/olsr-module.h"
+#include "ns3/propagation-module.h"
 #include "ns3/yans-wifi-helper.h"
 #include "ns3/wifi-module.h"
 #include "ns3/netanim-module.h"
 
+#if defined(ENABLE_BUILD_VERSION) && __has_include("ns3/version.h")
+#include "ns3/version.h"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <iomanip>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <streambuf>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace ns3;
+using namespace dsr;
+
+NS_LOG_COMPONENT_DEFINE("RoutingAnalysis");
+
+// Recorded in the run summary; override with -DMANET_CODE_VERSION=... or --codeVersion.
+#ifndef MANET_CODE_VERSION
+#define MANET_CODE_VERSION "2.0"
+#endif
+
+class MyTimestampTag : public Tag
+{
+public:
+  Time m_timestamp;
+  uint32_t m_flowId = 0;
+  uint32_t m_seq = 0;
+
+  static TypeId GetTypeId()
+  {
+    static TypeId tid = TypeId("MyTimestampTag")
+                            .SetParent<Tag>()
+                            .AddConstructor<MyTimestampTag>();
+    return tid;
+  }
+
+  virtual TypeId GetInstanceTypeId() const override { return GetTypeId(); }
+  virtual uint32_t GetSerializedSize() const override { return 16; }
+  
+  virtual void Serialize(TagBuffer i) const override
+  {
+    i.WriteDouble(m_timestamp.GetSeconds());
+    i.WriteU32(m_flowId);
+    i.WriteU32(m_seq);
+  }
+
+  virtual void Deserialize(TagBuffer i) override
+  {
+    m_timestamp = Seconds(i.ReadDouble());
+    m_flowId = i.ReadU32();
+    m_seq = i.ReadU32();
+  }
+
+  virtual void Print(std::ostream& os) const override
+  {
+    os << "Timestamp=" << m_timestamp.GetSeconds() << " Flow=" << m_flowId << " Seq=" << m_seq;
+  }
+
+  void SetTimestamp(Time time) { m_timestamp = time; }
+  Time GetTimestamp() const { return m_timestamp; }
+
+  // Identifies one data packet: its flow and its sequence number in the flow.
+  void SetPacketId(uint32_t flowId, uint32_t seq)
+  {
+    m_flowId = flowId;
+    m_seq = seq;
+  }
+  uint64_t GetPacketId() const { return (static_cast<uint64_t>(m_flowId) << 32) | m_seq; }
+};
+
+// Per-family accounting state filled in by the receive-path metric policies.
+struct DelayStats
+{
+  double total = 0.0;
+  uint32_t samples = 0;
+  double min = std::numeric_limits<double>::max();
+  double max = 0.0;
+
+  void Record(double delaySeconds)
+  {
+    total += delaySeconds;
+    samples++;
+    if (delaySeconds < min)
+      min = delaySeconds;
+    if (delaySeconds > max)
+      max = delaySeconds;
+  }
+
+  double Mean() const { return (samples == 0) ? 0.0 : total / samples; }
+};
+
+class RollupEngine;
+
+struct MetricState
+{
+  DelayStats delay;
+  RollupEngine* rollups = nullptr;
+};
+
+// Receive-path metric policies. ReceivePacket() is instantiated with the
+// policies selected for the run and the sink callback is bound once, so a
+// disabled family adds no code to the per-packet path.
+struct DelayMetric
+{
+  static void OnReceive(const Ptr<Packet>& packet, MetricState& state)
+  {
+    MyTimestampTag tag;
+    if (packet->PeekPacketTag(tag))
+    {
+      state.delay.Record((Simulator::Now() - tag.GetTimestamp()).GetSeconds());
+    }
+  }
+};
+
+// Output file written in large blocks. With compression the data is piped
+// through a gzip process, so compressing never runs on the writing thread.
+class OutputFile
+{
+public:
+  OutputFile() : m_file(nullptr), m_pipe(false), m_buffer(1 << 20) {}
+  ~OutputFile() { Close(); }
+
+  // Appends ".gz" to the path when compressing.
+  bool Open(const std::string& path, bool compress)
+  {
+    m_path = compress ? path + ".gz" : path;
+    m_pipe = compress;
+    if (compress)
+    {
+      std::string command = "gzip -c > " + ShellQuote(m_path);
+      m_file = popen(command.c_str(), "w");
+    }
+    else
+    {
+      m_file = std::fopen(m_path.c_str(), "w");
+    }
+    if (m_file)
+      std::setvbuf(m_file, m_buffer.data(), _IOFBF, m_buffer.size());
+    return m_file != nullptr;
+  }
+
+  void Write(const char* data, size_t len)
+  {
+    if (m_file)
+      std::fwrite(data, 1, len, m_file);
+  }
+
+  void Write(const std::string& data) { Write(data.data(), data.size()); }
+
+  void Flush()
+  {
+    if (m_file)
+      std::fflush(m_file);
+  }
+
+  void Close()
+  {
+    if (!m_file)
+      return;
+    if (m_pipe)
+      pclose(m_file);
+    else
+      std::fclose(m_file);
+    m_file = nullptr;
+  }
+
+  bool IsOpen() const { return m_file != nullptr; }
+  const std::string& GetPath() const { return m_path; }
+
+  static std::string ShellQuote(const std::string& value)
+  {
+    std::string out = "'";
+    for (char c : value)
+      out += (c == '\'') ? std::string("'\\''") : std::string(1, c);
+    return out + "'";
+  }
+
+private:
+  FILE* m_file;
+  bool m_pipe;
+  std::vector<char> m_buffer;
+  std::string m_path;
+};
+
+// Adapts an OutputFile to std::ostream for text writers.
+class OutputFileBuf : public std::streambuf
+{
+public:
+  explicit OutputFileBuf(OutputFile& file) : m_file(file) {}
+
+protected:
+  int overflow(int c) override
+  {
+    if (c != traits_type::eof())
+    {
+      char ch = static_cast<char>(c);
+      m_file.Write(&ch, 1);
+    }
+    return c;
+  }
+
+  std::streamsize xsputn(const char* s, std::streamsize n) override
+  {
+    m_file.Write(s, n);
+    return n;
+  }
+
+  int sync() override
+  {
+    m_file.Flush();
+    return 0;
+  }
+
+private:
+  OutputFile& m_file;
+};
+
+// One interval row of the output CSV. Records stay binary on the
+// simulator thread and are formatted by the metrics writer thread.
+struct MetricsRecord
+{
+  static constexpr size_t kMaxExtraColumns = 8;
+
+  double time;
+  double throughputKbps;
+  uint32_t packetsReceived;
+  double pdr;
+  double avgDelay;
+  uint32_t routingPackets;
+  // Values of the optional columns registered with MetricsWriter::AddColumn().
+  std::array<double, kMaxExtraColumns> extra{};
+};
+
+// Bounded single-producer/single-consumer ring. One slot is kept empty
+// to tell a full ring from an empty one.
+template <typename T, size_t Capacity>
+class SpscRing
+{
+public:
+  bool TryPush(const T& item)
+  {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    size_t next = (head + 1) % Capacity;
+    if (next == m_tail.load(std::memory_order_acquire))
+      return false;
+    m_items[head] = item;
+    m_head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Only meaningful on the consumer side.
+  bool Empty() const
+  {
+    return m_tail.load(std::memory_order_relaxed) == m_head.load(std::memory_order_acquire);
+  }
+
+  bool TryPop(T& item)
+  {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head.load(std::memory_order_acquire))
+      return false;
+    item = m_items[tail];
+    m_tail.store((tail + 1) % Capacity, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::array<T, Capacity> m_items;
+  alignas(64) std::atomic<size_t> m_head{0};
+  alignas(64) std::atomic<size_t> m_tail{0};
+};
+
+// Formats and writes interval records on a background thread so file I/O
+// never stalls the event loop. Every drained batch is flushed, so a run
+// that is killed keeps the rows written so far. The thread sleeps on a
+// condition variable between batches. Push() notifies it without taking
+// the lock, so a wakeup can be missed; the kIdleWait timeout bounds how
+// long a row then waits. Close() drains every queued record.
+// Optionally each formatted row is also published as one datagram on a
+// local UNIX socket; rows are dropped whenever no reader is bound there.
+class MetricsWriter
+{
+public:
+  static constexpr std::chrono::milliseconds kIdleWait{200};
+
+  MetricsWriter() : m_running(false), m_liveFd(-1), m_liveDropped(0), m_livePublished(0) {}
+  ~MetricsWriter() { Close(); }
+
+  // Must be called before Open(). Returns false if the path is unusable.
+  bool EnableLiveStream(const std::string& path)
+  {
+    if (path.size() >= sizeof(m_liveAddr.sun_path))
+      return false;
+    m_liveFd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (m_liveFd < 0)
+      return false;
+    std::memset(&m_liveAddr, 0, sizeof(m_liveAddr));
+    m_liveAddr.sun_family = AF_UNIX;
+    std::strncpy(m_liveAddr.sun_path, path.c_str(), sizeof(m_liveAddr.sun_path) - 1);
+    return true;
+  }
+
+  // Registers an optional column appended after the fixed ones; must be
+  // called before Open(). Returns the index into MetricsRecord::extra.
+  size_t AddColumn(const std::string& name)
+  {
+    NS_ABORT_MSG_IF(m_extraColumns.size() == MetricsRecord::kMaxExtraColumns, "Too many CSV columns");
+    m_extraColumns.push_back(name);
+    return m_extraColumns.size() - 1;
+  }
+
+  uint64_t GetLivePublished() const { return m_livePublished; }
+  uint64_t GetLiveDropped() const { return m_liveDropped; }
+
+  bool Open(const std::string& fileName, bool compress, int nSinks, const std::string& protocol, double txp)
+  {
+    m_nSinks = nSinks;
+    m_protocol = protocol;
+    m_txp = txp;
+
+    if (!m_out.Open(fileName, compress))
+      return false;
+    std::string header = "Time,ThroughputKbps,PacketsReceived,Sinks,Protocol,TxPower,PDR,AvgDelay,RoutingOverhead";
+    for (const std::string& column : m_extraColumns)
+      header += "," + column;
+    m_out.Write(header + "\n");
+
+    m_running.store(true, std::memory_order_release);
+    m_thread = std::thread(&MetricsWriter::WriterLoop, this);
+    return true;
+  }
+
+  const std::string& GetPath() const { return m_out.GetPath(); }
+
+  // Called from the simulator thread. Blocks only while the ring is full.
+  void Push(const MetricsRecord& record)
+  {
+    while (!m_ring.TryPush(record))
+    {
+      std::this_thread::yield();
+    }
+    m_wake.notify_one();
+  }
+
+  void Close()
+  {
+    if (!m_thread.joinable())
+      return;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_running.store(false, std::memory_order_release);
+    }
+    m_wake.notify_one();
+    m_thread.join();
+    m_out.Close();
+    if (m_liveFd >= 0)
+    {
+      close(m_liveFd);
+      m_liveFd = -1;
+    }
+  }
+
+private:
+  void WriterLoop()
+  {
+    MetricsRecord record;
+    for (;;)
+    {
+      // Read the flag before draining so records pushed ahead of Close()
+      // are always written.
+      bool running = m_running.load(std::memory_order_acquire);
+      bool wrote = false;
+      while (m_ring.TryPop(record))
+      {
+        Format(record);
+        wrote = true;
+      }
+      if (wrote)
+        m_out.Flush();
+      if (!running)
+        break;
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait_for(lock, kIdleWait, [this] {
+        return !m_running.load(std::memory_order_acquire) || !m_ring.Empty();
+      });
+    }
+  }
+
+  void Format(const MetricsRecord& r)
+  {
+    char line[512];
+    int len = std::snprintf(line, sizeof(line), "%.4f,%.4f,%u,%d,%s,%.4f,%.4f,%.4f,%u",
+                            r.time, r.throughputKbps, r.packetsReceived, m_nSinks,
+                            m_protocol.c_str(), m_txp, r.pdr, r.avgDelay, r.routingPackets);
+    len = std::min<int>(len, sizeof(line) - 2);
+    for (size_t i = 0; i < m_extraColumns.size() && len < (int)sizeof(line) - 2; ++i)
+    {
+      len += std::snprintf(line + len, sizeof(line) - 1 - len, ",%.6g", r.extra[i]);
+      len = std::min<int>(len, sizeof(line) - 2);
+    }
+    line[len++] = '\n';
+    m_out.Write(line, len);
+
+    if (m_liveFd >= 0)
+    {
+      Publish(line, len);
+    }
+  }
+
+  // Never blocks: a missing or slow reader just loses the datagram.
+  void Publish(const char* line, int len)
+  {
+    ssize_t sent = sendto(m_liveFd, line, len, MSG_DONTWAIT,
+                          reinterpret_cast<const sockaddr*>(&m_liveAddr), sizeof(m_liveAddr));
+    if (sent < 0)
+      m_liveDropped++;
+    else
+      m_livePublished++;
+  }
+
+  SpscRing<MetricsRecord, 1024> m_ring;
+  std::atomic<bool> m_running;
+  std::thread m_thread;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  OutputFile m_out;
+  int m_nSinks;
+  std::string m_protocol;
+  double m_txp;
+  std::vector<std::string> m_extraColumns;
+
+  int m_liveFd;
+  sockaddr_un m_liveAddr;
+  uint64_t m_liveDropped;
+  uint64_t m_livePublished;
+};
+
+// Mergeable log-bucket quantile sketch. Bin i holds values in
+// (kMin * gamma^(i-1), kMin * gamma^i], so every quantile is reported within
+// kAccuracy relative error, memory is fixed, and two sketches merge by
+// adding their bins.
+class QuantileSketch
+{
+public:
+  static constexpr double kAccuracy = 0.05;
+  static constexpr double kMin = 1e-6;
+  static constexpr size_t kBins = 280; // up to ~1e6
+
+  void Add(double value) { m_bins[Index(value)]++; }
+
+  void Merge(const QuantileSketch& other)
+  {
+    for (size_t i = 0; i < kBins; ++i)
+      m_bins[i] += other.m_bins[i];
+  }
+
+  void Clear() { m_bins.fill(0); }
+
+  double Quantile(double q, uint64_t count) const
+  {
+    if (count == 0)
+      return 0.0;
+    uint64_t rank = static_cast<uint64_t>(q * (count - 1));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBins; ++i)
+    {
+      seen += m_bins[i];
+      if (seen > rank)
+        return (i == 0) ? kMin : kMin * 2.0 * std::pow(Gamma(), i) / (Gamma() + 1.0);
+    }
+    return kMin * std::pow(Gamma(), kBins - 1);
+  }
+
+private:
+  static double Gamma() { return (1.0 + kAccuracy) / (1.0 - kAccuracy); }
+
+  static size_t Index(double value)
+  {
+    static const double logGamma = std::log(Gamma());
+    if (value <= kMin)
+      return 0;
+    double index = std::ceil(std::log(value / kMin) / logGamma);
+    return std::min(static_cast<size_t>(index), kBins - 1);
+  }
+
+  std::array<uint32_t, kBins> m_bins{};
+};
+
+// Count, sum, min, max and quantile sketch of one metric over one bucket.
+struct RollupBucket
+{
+  uint64_t count = 0;
+  double sum = 0.0;
+  double min = 0.0;
+  double max = 0.0;
+  QuantileSketch sketch;
+
+  void Add(double value)
+  {
+    min = (count == 0) ? value : std::min(min, value);
+    max = (count == 0) ? value : std::max(max, value);
+    count++;
+    sum += value;
+    sketch.Add(value);
+  }
+
+  void Merge(const RollupBucket& other)
+  {
+    if (other.count == 0)
+      return;
+    min = (count == 0) ? other.min : std::min(min, other.min);
+    max = (count == 0) ? other.max : std::max(max, other.max);
+    count += other.count;
+    sum += other.sum;
+    sketch.Merge(other.sketch);
+  }
+
+  void Clear() { *this = RollupBucket(); }
+};
+
+// Multi-resolution rollups of the event-level metrics at 100 ms, 1 s, 10 s
+// and 60 s. Samples only touch the open 100 ms bucket; Tick() closes it
+// every 100 ms of simulated time and merges it into the next level, which
+// closes in turn every 10, 100 and 600 ticks. Closed buckets wait in a
+// small per-level ring that is written out when full, so memory stays
+// constant however long the run is. Each level goes to its own file.
+class RollupEngine
+{
+public:
+  enum Metric
+  {
+    SENT,     // bytes per sent data packet
+    RECEIVED, // bytes per received data packet
+    DELAY,    // end-to-end delay per received data packet (s)
+    ROUTING,  // bytes per routing packet sent by the MAC
+    METRIC_COUNT
+  };
+
+  static constexpr size_t kLevels = 4;
+
+  RollupEngine() : m_ticks(0), m_levelStart{}
+  {
+    for (std::vector<ClosedRow>& ring : m_ring)
+      ring.reserve(kRingSize);
+  }
+
+  // Opens <prefix>-100ms.csv ... <prefix>-60s.csv.
+  bool Open(const std::string& prefix, bool compress)
+  {
+    for (size_t level = 0; level < kLevels; ++level)
+    {
+      if (!m_out[level].Open(prefix + "-" + kLevelNames[level] + ".csv", compress))
+        return false;
+      m_out[level].Write("Time,Metric,Count,Sum,Min,Max,P50,P90,P99\n");
+    }
+    return true;
+  }
+
+  bool IsOpen() const { return m_out[0].IsOpen(); }
+  const char* GetLevelName(size_t level) const { return kLevelNames[level]; }
+  const std::string& GetPath(size_t level) const { return m_out[level].GetPath(); }
+
+  void Add(Metric metric, double value) { m_open[0][metric].Add(value); }
+
+  // Called every 100 ms of simulated time.
+  void Tick(double now)
+  {
+    m_ticks++;
+    CloseLevel(0, now);
+    for (size_t level = 1; level < kLevels && m_ticks % kTicksPerBucket[level] == 0; ++level)
+      CloseLevel(level, now);
+  }
+
+  // Emits the partially filled buckets of every level and flushes the files.
+  void Close(double now)
+  {
+    if (!IsOpen())
+      return;
+    for (size_t level = 0; level < kLevels; ++level)
+    {
+      if (now > m_levelStart[level])
+        CloseLevel(level, now);
+      Drain(level);
+      m_out[level].Close();
+    }
+  }
+
+private:
+  static constexpr size_t kRingSize = 16;
+  static constexpr const char* kLevelNames[kLevels] = {"100ms", "1s", "10s", "60s"};
+  static constexpr uint64_t kTicksPerBucket[kLevels] = {1, 10, 100, 600};
+  static constexpr const char* kMetricNames[METRIC_COUNT] = {"Sent", "Received", "Delay", "Routing"};
+
+  using Row = std::array<RollupBucket, METRIC_COUNT>;
+
+  struct ClosedRow
+  {
+    double time;
+    Row buckets;
+  };
+
+  void CloseLevel(size_t level, double now)
+  {
+    Row& open = m_open[level];
+    if (level + 1 < kLevels)
+    {
+      for (size_t m = 0; m < METRIC_COUNT; ++m)
+        m_open[level + 1][m].Merge(open[m]);
+    }
+
+    if (m_ring[level].size() == kRingSize)
+      Drain(level);
+    m_ring[level].push_back({now, open});
+
+    for (RollupBucket& bucket : open)
+      bucket.Clear();
+    m_levelStart[level] = now;
+  }
+
+  void Drain(size_t level)
+  {
+    char line[256];
+    for (const ClosedRow& row : m_ring[level])
+    {
+      for (size_t m = 0; m < METRIC_COUNT; ++m)
+      {
+        const RollupBucket& b = row.buckets[m];
+        int len = std::snprintf(line, sizeof(line), "%.1f,%s,%llu,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g\n",
+                                row.time, kMetricNames[m],
+                                static_cast<unsigned long long>(b.count), b.sum, b.min, b.max,
+                                b.sketch.Quantile(0.50, b.count), b.sketch.Quantile(0.90, b.count),
+                                b.sketch.Quantile(0.99, b.count));
+        m_out[level].Write(line, std::min<int>(len, sizeof(line) - 1));
+      }
+    }
+    m_ring[level].clear();
+  }
+
+  uint64_t m_ticks;
+  std::array<double, kLevels> m_levelStart;
+  std::array<Row, kLevels> m_open;
+  std::array<std::vector<ClosedRow>, kLevels> m_ring;
+  std::array<OutputFile, kLevels> m_out;
+};
+
+// Receive-path policy feeding the rollups with received bytes and delay.
+struct RollupMetric
+{
+  static void OnReceive(const Ptr<Packet>& packet, MetricState& state)
+  {
+    state.rollups->Add(RollupEngine::RECEIVED, packet->GetSize());
+    MyTimestampTag tag;
+    if (packet->PeekPacketTag(tag))
+    {
+      state.rollups->Add(RollupEngine::DELAY, (Simulator::Now() - tag.GetTimestamp()).GetSeconds());
+    }
+  }
+};
+
+enum class Verbosity
+{
+  SILENT,
+  SUMMARY,
+  VERBOSE
+};
+
+// Single buffered sink for all console-style output of a run. Messages
+// above the configured verbosity are never formatted; the rest go to the
+// per-run log file, or to stdout when no file is given.
+class RunLogger
+{
+public:
+  RunLogger() : m_level(Verbosity::VERBOSE), m_buf(m_file), m_stream(&m_buf) {}
+  ~RunLogger() { Close(); }
+
+  bool Open(Verbosity level, const std::string& fileName, bool compress)
+  {
+    m_level = level;
+    if (fileName.empty() || level == Verbosity::SILENT)
+      return true;
+    return m_file.Open(fileName, compress);
+  }
+
+  bool Enabled(Verbosity level) const { return level <= m_level; }
+  std::ostream& Stream() { return m_file.IsOpen() ? m_stream : std::cout; }
+  void Flush() { Stream().flush(); }
+
+  void Close()
+  {
+    if (m_file.IsOpen())
+    {
+      m_stream.flush();
+      m_file.Close();
+    }
+    else
+    {
+      std::cout.flush();
+    }
+  }
+
+  static bool ParseVerbosity(const std::string& name, Verbosity& level)
+  {
+    if (name == "silent")
+      level = Verbosity::SILENT;
+    else if (name == "summary")
+      level = Verbosity::SUMMARY;
+    else if (name == "verbose")
+      level = Verbosity::VERBOSE;
+    else
+      return false;
+    return true;
+  }
+
+private:
+  Verbosity m_level;
+  OutputFile m_file;
+  OutputFileBuf m_buf;
+  std::ostream m_stream;
+};
+
+#define RUN_LOG(logger, level, msg)                                                          \
+  do                                                                                         \
+  {                                                                                          \
+    if ((logger).Enabled(Verbosity::level))                                                  \
+    {                                                                                        \
+      (logger).Stream() << msg << '\n';                                                      \
+    }                                                                                        \
+  } while (false)
+
+// Minimal ordered JSON object used for the machine-readable run summary.
+class JsonObject
+{
+public:
+  JsonObject& AddString(const std::string& key, const std::string& value)
+  {
+    return AddRaw(key, Quote(value));
+  }
+
+  JsonObject& AddNumber(const std::string& key, double value)
+  {
+    if (!std::isfinite(value))
+      return AddRaw(key, "null");
+    std::ostringstream os;
+    os << std::setprecision(10) << value;
+    return AddRaw(key, os.str());
+  }
+
+  JsonObject& AddInt(const std::string& key, int64_t value)
+  {
+    return AddRaw(key, std::to_string(value));
+  }
+
+  JsonObject& AddBool(const std::string& key, bool value)
+  {
+    return AddRaw(key, value ? "true" : "false");
+  }
+
+  JsonObject& AddObject(const std::string& key, const JsonObject& value)
+  {
+    m_fields.push_back({key, "", std::make_shared<JsonObject>(value)});
+    return *this;
+  }
+
+  std::string Str(int depth = 0) const
+  {
+    std::string pad(2 * (depth + 1), ' ');
+    std::string out = "{";
+    for (size_t i = 0; i < m_fields.size(); ++i)
+    {
+      out += (i == 0) ? "\n" : ",\n";
+      const Field& field = m_fields[i];
+      out += pad + Quote(field.key) + ": " + (field.child ? field.child->Str(depth + 1) : field.json);
+    }
+    out += "\n" + std::string(2 * depth, ' ') + "}";
+    return out;
+  }
+
+private:
+  JsonObject& AddRaw(const std::string& key, const std::string& json)
+  {
+    m_fields.push_back({key, json, nullptr});
+    return *this;
+  }
+
+  static std::string Quote(const std::string& value)
+  {
+    std::string out = "\"";
+    for (char c : value)
+    {
+      switch (c)
+      {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20)
+        {
+          char buf[8];
+          std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+          out += buf;
+        }
+        else
+        {
+          out += c;
+        }
+      }
+    }
+    return out + "\"";
+  }
+
+  struct Field
+  {
+    std::string key;
+    std::string json;
+    std::shared_ptr<JsonObject> child;
+  };
+
+  std::vector<Field> m_fields;
+};
+
+// One routing-table entry as captured by the snapshot writer. Expiry is an
+// absolute simulation time in ms (0 when the protocol has none), so an
+// entry only differs from its previous snapshot when the route changed
+// or was refreshed.
+struct RouteEntry
+{
+  uint32_t destination;
+  uint32_t nextHop;
+  uint16_t hops;
+  uint32_t seqNo;
+  int32_t expiryMs;
+
+  bool operator==(const RouteEntry& o) const
+  {
+    return destination == o.destination && nextHop == o.nextHop && hops == o.hops &&
+           seqNo == o.seqNo && expiryMs == o.expiryMs;
+  }
+};
+
+// Writes per-node routing tables as delta-encoded binary records.
+//
+// File header: "MRTS", uint16 version, uint16 reserved, uint32 node count.
+// Node block:  double time, uint32 node, uint16 changed, uint16 removed,
+//              changed x {u32 dest, u32 nextHop, u16 hops, u32 seqNo,
+//              i32 expiryMs}, removed x {u32 dest}.
+// Blocks are only written for nodes whose table changed; all values are
+// in host byte order.
+class RoutingSnapshotWriter
+{
+public:
+  bool Open(const std::string& fileName, bool compress, uint32_t nNodes)
+  {
+    if (!m_out.Open(fileName, compress))
+      return false;
+    m_previous.assign(nNodes, std::map<uint32_t, RouteEntry>());
+    m_out.Write("MRTS", 4);
+    Put<uint16_t>(1);
+    Put<uint16_t>(0);
+    Put<uint32_t>(nNodes);
+    return true;
+  }
+
+  void Write(double time, uint32_t node, const std::vector<RouteEntry>& entries)
+  {
+    std::map<uint32_t, RouteEntry>& previous = m_previous[node];
+    std::map<uint32_t, RouteEntry> current;
+    std::vector<const RouteEntry*> changed;
+    for (const RouteEntry& entry : entries)
+    {
+      current[entry.destination] = entry;
+      auto it = previous.find(entry.destination);
+      if (it == previous.end() || !(it->second == entry))
+        changed.push_back(&entry);
+    }
+    std::vector<uint32_t> removed;
+    for (const auto& kv : previous)
+    {
+      if (current.find(kv.first) == current.end())
+        removed.push_back(kv.first);
+    }
+
+    if (!changed.empty() || !removed.empty())
+    {
+      Put<double>(time);
+      Put<uint32_t>(node);
+      Put<uint16_t>(changed.size());
+      Put<uint16_t>(removed.size());
+      for (const RouteEntry* entry : changed)
+      {
+        Put<uint32_t>(entry->destination);
+        Put<uint32_t>(entry->nextHop);
+        Put<uint16_t>(entry->hops);
+        Put<uint32_t>(entry->seqNo);
+        Put<int32_t>(entry->expiryMs);
+      }
+      for (uint32_t destination : removed)
+        Put<uint32_t>(destination);
+    }
+    previous.swap(current);
+  }
+
+  void Close() { m_out.Close(); }
+  bool IsOpen() const { return m_out.IsOpen(); }
+  const std::string& GetPath() const { return m_out.GetPath(); }
+
+private:
+  template <typename T>
+  void Put(T value)
+  {
+    m_out.Write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  OutputFile m_out;
+  std::vector<std::map<uint32_t, RouteEntry>> m_previous;
+};
+
+// Per-node packet capture limited to a time window and, optionally, to the
+// seconds after an interval-metric trigger fired. Packets outside the
+// active window are never serialized.
+class PcapCapture
+{
+public:
+  PcapCapture() : m_start(0.0), m_stop(0.0), m_triggered(false), m_armedUntil(-1.0) {}
+
+  void Configure(double start, double stop, bool triggered)
+  {
+    m_start = start;
+    m_stop = stop;
+    m_triggered = triggered;
+  }
+
+  void Attach(Ptr<NetDevice> device, const std::string& fileName, uint32_t snapLen)
+  {
+    Ptr<WifiNetDevice> wifiDevice = DynamicCast<WifiNetDevice>(device);
+    if (!wifiDevice)
+      return;
+
+    PcapHelper pcapHelper;
+    Ptr<PcapFileWrapper> file =
+        pcapHelper.CreateFile(fileName, std::ios::out, PcapHelper::DLT_IEEE802_11, snapLen);
+    wifiDevice->GetPhy()->TraceConnectWithoutContext(
+        "PhyTxBegin", MakeBoundCallback(&PcapCapture::SniffTx, this, file));
+    wifiDevice->GetPhy()->TraceConnectWithoutContext(
+        "PhyRxEnd", MakeBoundCallback(&PcapCapture::SniffRx, this, file));
+    m_files.push_back(file);
+  }
+
+  // Keeps capture enabled until now + hold.
+  void Arm(double hold) { m_armedUntil = Simulator::Now().GetSeconds() + hold; }
+
+  bool Active() const
+  {
+    double now = Simulator::Now().GetSeconds();
+    if (now < m_start || (m_stop > 0.0 && now > m_stop))
+      return false;
+    return !m_triggered || now <= m_armedUntil;
+  }
+
+  size_t GetFileCount() const { return m_files.size(); }
+
+private:
+  static void SniffTx(PcapCapture* capture, Ptr<PcapFileWrapper> file, Ptr<const Packet> packet, double /* txPowerW */)
+  {
+    if (capture->Active())
+      file->Write(Simulator::Now(), packet);
+  }
+
+  static void SniffRx(PcapCapture* capture, Ptr<PcapFileWrapper> file, Ptr<const Packet> packet)
+  {
+    if (capture->Active())
+      file->Write(Simulator::Now(), packet);
+  }
+
+  double m_start;
+  double m_stop;
+  bool m_triggered;
+  double m_armedUntil;
+  std::vector<Ptr<PcapFileWrapper>> m_files;
+};
+
+// Route-discovery flood accounting for AODV and DSR route requests, fed by
+// the IPv4 Tx/Rx traces of every node. A flood is keyed by originator and
+// request id. A rebroadcast is redundant when no node hears it first from
+// that transmitter. Floods are finalized kFloodTimeout seconds after they
+// start, so only floods still in flight are held in memory.
+class FloodTracker
+{
+public:
+  static constexpr double kFloodTimeout = 10.0;
+
+  FloodTracker()
+      : m_enabled(false), m_floods(0), m_transmissions(0), m_rebroadcasts(0), m_redundant(0),
+        m_receptions(0), m_duplicates(0), m_reachTotal(0), m_completionTotal(0.0)
+  {
+  }
+
+  bool Open(const std::string& fileName, bool compress, const Ipv4InterfaceContainer& interfaces)
+  {
+    if (!m_out.Open(fileName, compress))
+      return false;
+    m_out.Write("Origin,RequestId,Start,Transmissions,Rebroadcasts,Redundant,Receptions,"
+                "Duplicates,Reach,CompletionTime\n");
+    for (uint32_t i = 0; i < interfaces.GetN(); ++i)
+      m_nodeByAddress[interfaces.GetAddress(i).Get()] = i;
+    m_enabled = true;
+    return true;
+  }
+
+  void Attach(Ptr<Node> node)
+  {
+    Ptr<Ipv4L3Protocol> ipv4 = node->GetObject<Ipv4L3Protocol>();
+    ipv4->TraceConnectWithoutContext("Tx", MakeBoundCallback(&FloodTracker::IpTx, this));
+    ipv4->TraceConnectWithoutContext("Rx", MakeBoundCallback(&FloodTracker::IpRx, this, node->GetId()));
+  }
+
+  // Finalizes every flood still in flight.
+  void Close()
+  {
+    if (!m_out.IsOpen())
+      return;
+    Expire(std::numeric_limits<double>::max());
+    m_out.Close();
+  }
+
+  bool IsEnabled() const { return m_enabled; }
+  const std::string& GetPath() const { return m_out.GetPath(); }
+  uint64_t GetFloods() const { return m_floods; }
+  uint64_t GetRebroadcasts() const { return m_rebroadcasts; }
+  uint64_t GetDuplicates() const { return m_duplicates; }
+  double GetRedundantRatio() const { return (m_rebroadcasts == 0) ? 0.0 : (double)m_redundant / m_rebroadcasts; }
+  double GetDuplicateRatio() const { return (m_receptions == 0) ? 0.0 : (double)m_duplicates / m_receptions; }
+  double GetMeanReach() const { return (m_floods == 0) ? 0.0 : (double)m_reachTotal / m_floods; }
+  double GetMeanCompletion() const { return (m_floods == 0) ? 0.0 : m_completionTotal / m_floods; }
+
+private:
+  struct Flood
+  {
+    uint32_t origin;
+    uint32_t id;
+    double start;
+    double lastFirstReception;
+    uint32_t transmissions = 0;
+    uint32_t receptions = 0;
+    std::vector<bool> transmitted; // by node
+    std::vector<bool> reached;     // by node, originator included
+    std::vector<bool> useful;      // transmitters that delivered a first copy
+  };
+
+  // Extracts (originator, request id, transmitter address) from an IPv4
+  // packet carrying an AODV or DSR route request.
+  static bool ParseRequest(Ptr<const Packet> packet, uint32_t& origin, uint32_t& id, uint32_t& transmitter)
+  {
+    Ptr<Packet> copy = packet->Copy();
+    Ipv4Header ip;
+    copy->RemoveHeader(ip);
+
+    if (ip.GetProtocol() == UdpL4Protocol::PROT_NUMBER)
+    {
+      UdpHeader udp;
+      copy->RemoveHeader(udp);
+      if (udp.GetDestinationPort() != aodv::RoutingProtocol::AODV_PORT)
+        return false;
+      aodv::TypeHeader type;
+      copy->RemoveHeader(type);
+      if (!type.IsValid() || type.Get() != aodv::AODVTYPE_RREQ)
+        return false;
+      aodv::RreqHeader rreq;
+      copy->RemoveHeader(rreq);
+      origin = rreq.GetOrigin().Get();
+      id = rreq.GetId();
+      transmitter = ip.GetSource().Get();
+      return true;
+    }
+
+    if (ip.GetProtocol() == DsrRouting::PROT_NUMBER)
+    {
+      // Same walk as DsrRouting::Receive: skip the fixed header, peek the
+      // option type and size the request by its address count.
+      Ptr<Packet> options = copy->Copy();
+      DsrRoutingHeader dsrHeader;
+      copy->RemoveHeader(dsrHeader);
+      options->RemoveAtStart(dsrHeader.GetDsrOptionsOffset());
+      uint8_t buf[2];
+      if (options->CopyData(buf, sizeof(buf)) < sizeof(buf) || buf[0] != 1)
+        return false;
+      DsrOptionRreqHeader rreq;
+      rreq.SetNumberAddress((buf[1] - 6) / 4);
+      options->RemoveHeader(rreq);
+      if (rreq.GetNodesNumber() == 0)
+        return false;
+      // Every forwarder appends itself, so the last address is the sender.
+      origin = rreq.GetNodeAddress(0).Get();
+      id = rreq.GetId();
+      transmitter = rreq.GetNodeAddress(rreq.GetNodesNumber() - 1).Get();
+      return true;
+    }
+    return false;
+  }
+
+  static uint64_t Key(uint32_t origin, uint32_t id) { return (static_cast<uint64_t>(origin) << 32) | id; }
+
+  Flood* Find(uint32_t origin, uint32_t id, bool create)
+  {
+    auto it = m_active.find(Key(origin, id));
+    if (it != m_active.end())
+      return &it->second;
+    if (!create)
+      return nullptr;
+
+    double now = Simulator::Now().GetSeconds();
+    Expire(now);
+    size_t n = m_nodeByAddress.size();
+    Flood& flood = m_active[Key(origin, id)];
+    flood.origin = origin;
+    flood.id = id;
+    flood.start = now;
+    flood.lastFirstReception = now;
+    flood.transmitted.assign(n, false);
+    flood.reached.assign(n, false);
+    flood.useful.assign(n, false);
+    auto originNode = m_nodeByAddress.find(origin);
+    if (originNode != m_nodeByAddress.end())
+      flood.reached[originNode->second] = true;
+    m_order.push_back({now, Key(origin, id)});
+    return &flood;
+  }
+
+  static void IpTx(FloodTracker* tracker, Ptr<const Packet> packet, Ptr<Ipv4> /* ipv4 */, uint32_t /* interface */)
+  {
+    uint32_t origin, id, transmitter;
+    if (!ParseRequest(packet, origin, id, transmitter))
+      return;
+    auto sender = tracker->m_nodeByAddress.find(transmitter);
+    if (sender == tracker->m_nodeByAddress.end())
+      return;
+    Flood* flood = tracker->Find(origin, id, true);
+    flood->transmissions++;
+    flood->transmitted[sender->second] = true;
+  }
+
+  static void IpRx(FloodTracker* tracker, uint32_t node, Ptr<const Packet> packet, Ptr<Ipv4> /* ipv4 */, uint32_t /* interface */)
+  {
+    uint32_t origin, id, transmitter;
+    if (!ParseRequest(packet, origin, id, transmitter))
+      return;
+    Flood* flood = tracker->Find(origin, id, false);
+    if (!flood)
+      return;
+    flood->receptions++;
+    if (flood->reached[node])
+      return;
+    flood->reached[node] = true;
+    flood->lastFirstReception = Simulator::Now().GetSeconds();
+    auto sender = tracker->m_nodeByAddress.find(transmitter);
+    if (sender != tracker->m_nodeByAddress.end())
+      flood->useful[sender->second] = true;
+  }
+
+  // Finalizes the floods that started more than kFloodTimeout before now.
+  void Expire(double now)
+  {
+    while (!m_order.empty() && m_order.front().first + kFloodTimeout <= now)
+    {
+      auto it = m_active.find(m_order.front().second);
+      m_order.pop_front();
+      if (it == m_active.end())
+        continue;
+      Finish(it->second);
+      m_active.erase(it);
+    }
+  }
+
+  void Finish(const Flood& flood)
+  {
+    auto originNode = m_nodeByAddress.find(flood.origin);
+    uint32_t rebroadcasts = 0;
+    uint32_t redundant = 0;
+    uint32_t reach = 0;
+    for (size_t i = 0; i < flood.reached.size(); ++i)
+    {
+      bool isOrigin = (originNode != m_nodeByAddress.end() && originNode->second == i);
+      if (flood.reached[i] && !isOrigin)
+        reach++;
+      if (flood.transmitted[i] && !isOrigin)
+      {
+        rebroadcasts++;
+        if (!flood.useful[i])
+          redundant++;
+      }
+    }
+    uint32_t duplicates = flood.receptions - reach;
+    double completion = flood.lastFirstReception - flood.start;
+
+    m_floods++;
+    m_transmissions += flood.transmissions;
+    m_rebroadcasts += rebroadcasts;
+    m_redundant += redundant;
+    m_receptions += flood.receptions;
+    m_duplicates += duplicates;
+    m_reachTotal += reach;
+    m_completionTotal += completion;
+
+    char line[192];
+    int len = std::snprintf(line, sizeof(line), "%s,%u,%.4f,%u,%u,%u,%u,%u,%u,%.6f\n",
+                            Ipv4AddressString(flood.origin).c_str(), flood.id, flood.start,
+                            flood.transmissions, rebroadcasts, redundant, flood.receptions,
+                            duplicates, reach, completion);
+    m_out.Write(line, std::min<int>(len, sizeof(line) - 1));
+  }
+
+  static std::string Ipv4AddressString(uint32_t address)
+  {
+    std::ostringstream os;
+    Ipv4Address(address).Print(os);
+    return os.str();
+  }
+
+  bool m_enabled;
+  OutputFile m_out;
+  std::unordered_map<uint32_t, uint32_t> m_nodeByAddress;
+  std::unordered_map<uint64_t, Flood> m_active;
+  std::deque<std::pair<double, uint64_t>> m_order; // (start, key), oldest first
+
+  uint64_t m_floods;
+  uint64_t m_transmissions;
+  uint64_t m_rebroadcasts;
+  uint64_t m_redundant;
+  uint64_t m_receptions;
+  uint64_t m_duplicates;
+  uint64_t m_reachTotal;
+  double m_completionTotal;
+};
+
+// Two-generation Bloom filter. Inserts go to the current generation and
+// lookups check both. Generations cover aligned periods: Advance() rotates
+// once per whole period elapsed and clears both after two or more, so a
+// key is remembered for one to two periods in fixed memory, however long
+// the filter sat idle.
+class RotatingBloomFilter
+{
+public:
+  static constexpr size_t kBits = 4096;
+  static constexpr int kHashes = 3;
+
+  bool Contains(uint64_t key) const
+  {
+    uint64_t h1, h2;
+    Hashes(key, h1, h2);
+    bool current = true;
+    bool previous = true;
+    for (int i = 0; i < kHashes; ++i)
+    {
+      size_t bit = (h1 + i * h2) % kBits;
+      current = current && m_current[bit];
+      previous = previous && m_previous[bit];
+    }
+    return current || previous;
+  }
+
+  void Insert(uint64_t key)
+  {
+    uint64_t h1, h2;
+    Hashes(key, h1, h2);
+    for (int i = 0; i < kHashes; ++i)
+      m_current.set((h1 + i * h2) % kBits);
+  }
+
+  void Advance(double now, double period)
+  {
+    double periods = std::floor((now - m_rotated) / period);
+    if (periods < 1.0)
+      return;
+    if (periods >= 2.0)
+      m_previous.reset();
+    else
+      m_previous = m_current;
+    m_current.reset();
+    m_rotated += periods * period;
+  }
+
+private:
+  // splitmix64 finalizer; the two halves drive double hashing.
+  static void Hashes(uint64_t key, uint64_t& h1, uint64_t& h2)
+  {
+    uint64_t z = key + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    h1 = z & 0xffffffffULL;
+    h2 = (z >> 32) | 1;
+  }
+
+  std::bitset<kBits> m_current;
+  std::bitset<kBits> m_previous;
+  double m_rotated = 0.0;
+};
+
+// Flags data packets that come back to a node which already forwarded them.
+// Every node keeps the ids (flow, seq) of the data packets it handed to its
+// MAC in a rotating Bloom filter and checks IP receptions from the WiFi
+// interface against it. Only a neighbour can deliver the packet again, so
+// MAC retries and DSR retransmissions from the same node are not counted;
+// a DSR salvage counts only if its new route leads back through a node the
+// packet already crossed. Each return is one more lap to forward.
+// Per-node filters advance in kWindow periods, which bounds memory
+// whatever the traffic.
+class LoopDetector
+{
+public:
+  static constexpr double kWindow = 2.0;
+
+  LoopDetector()
+      : m_intervalLoopedPackets(0), m_intervalExtraTx(0), m_loopedPackets(0), m_extraTx(0)
+  {
+  }
+
+  // Needs the internet stack installed on the device's node.
+  void Attach(Ptr<NetDevice> device, uint32_t node)
+  {
+    Ptr<WifiNetDevice> wifiDevice = DynamicCast<WifiNetDevice>(device);
+    if (!wifiDevice)
+      return;
+    if (node >= m_nodes.size())
+      m_nodes.resize(node + 1);
+    wifiDevice->GetMac()->TraceConnectWithoutContext(
+        "MacTx", MakeBoundCallback(&LoopDetector::MacTx, this, node));
+    Ptr<Ipv4L3Protocol> ipv4 = device->GetNode()->GetObject<Ipv4L3Protocol>();
+    uint32_t interface = ipv4->GetInterfaceForDevice(device);
+    ipv4->TraceConnectWithoutContext("Rx", MakeBoundCallback(&LoopDetector::IpRx, this, node, interface));
+  }
+
+  // Counts since the previous call, for the interval CSV row.
+  void TakeInterval(uint32_t& loopedPackets, uint32_t& extraTx)
+  {
+    loopedPackets = m_intervalLoopedPackets;
+    extraTx = m_intervalExtraTx;
+    m_intervalLoopedPackets = 0;
+    m_intervalExtraTx = 0;
+  }
+
+  bool IsEnabled() const { return !m_nodes.empty(); }
+  uint64_t GetLoopedPackets() const { return m_loopedPackets; }
+  uint64_t GetExtraTransmissions() const { return m_extraTx; }
+
+private:
+  RotatingBloomFilter& Filter(uint32_t node, double now)
+  {
+    m_nodes[node].Advance(now, kWindow);
+    return m_nodes[node];
+  }
+
+  static void MacTx(LoopDetector* detector, uint32_t node, Ptr<const Packet> packet)
+  {
+    MyTimestampTag tag;
+    if (packet->PeekPacketTag(tag))
+      detector->Filter(node, Simulator::Now().GetSeconds()).Insert(tag.GetPacketId());
+  }
+
+  // Receptions on other interfaces (loopback, where AODV parks packets
+  // awaiting a route) do not come from a neighbour.
+  static void IpRx(LoopDetector* detector, uint32_t node, uint32_t wifiInterface, Ptr<const Packet> packet,
+                   Ptr<Ipv4> ipv4, uint32_t interface)
+  {
+    MyTimestampTag tag;
+    if (interface != wifiInterface || !packet->PeekPacketTag(tag))
+      return;
+
+    double now = Simulator::Now().GetSeconds();
+    uint64_t id = tag.GetPacketId();
+    if (!detector->Filter(node, now).Contains(id))
+      return;
+
+    detector->m_intervalExtraTx++;
+    detector->m_extraTx++;
+    // A packet circling a loop repeats at every node on it; count it once.
+    detector->m_looped.Advance(now, kWindow);
+    if (!detector->m_looped.Contains(id))
+    {
+      detector->m_looped.Insert(id);
+      detector->m_intervalLoopedPackets++;
+      detector->m_loopedPackets++;
+    }
+  }
+
+  std::vector<RotatingBloomFilter> m_nodes;
+  uint32_t m_intervalLoopedPackets;
+  uint32_t m_intervalExtraTx;
+  uint64_t m_loopedPackets;
+  uint64_t m_extraTx;
+  RotatingBloomFilter m_looped;
+};
+
+// Samples queue occupancy every kSamplePeriod seconds into per-interval
+// mean/max aggregates. MAC queues are read per node from the non-QoS Txop.
+// The routing protocols keep their packet buffers (AODV request queue, DSR
+// send buffer, DSDV pending queue) private, so the source-side routing
+// buffer is estimated: a data packet counts as buffered from the socket
+// send until its source hands it to the MAC. Buffers are FIFO per
+// destination, so a packet reaching the MAC retires every older pending
+// one of its flow (those were dropped), and entries older than the
+// protocols' 30 s queue timeout expire.
+class QueueMonitor
+{
+public:
+  static constexpr double kSamplePeriod = 0.1;
+  static constexpr double kMaxBufferTime = 30.0;
+  static constexpr size_t kMaxPendingPerFlow = 256;
+
+  QueueMonitor() : m_nSinks(0) { ResetInterval(); }
+
+  void Setup(const NetDeviceContainer& devices, uint32_t nSinks)
+  {
+    m_nSinks = nSinks;
+    m_pending.assign(nSinks, std::deque<std::pair<uint32_t, double>>());
+    for (uint32_t i = 0; i < devices.GetN(); ++i)
+    {
+      Ptr<WifiNetDevice> wifiDevice = DynamicCast<WifiNetDevice>(devices.Get(i));
+      if (!wifiDevice)
+        continue;
+      m_macQueues.push_back(wifiDevice->GetMac()->GetTxopQueue(AC_BE_NQOS));
+      wifiDevice->GetMac()->TraceConnectWithoutContext(
+          "MacTx", MakeBoundCallback(&QueueMonitor::MacTx, this, i));
+    }
+  }
+
+  bool IsEnabled() const { return m_nSinks > 0; }
+
+  // Called for every data packet accepted by a source socket.
+  void OnSend(uint32_t flowId, uint32_t seq)
+  {
+    std::deque<std::pair<uint32_t, double>>& pending = m_pending[flowId];
+    if (pending.size() == kMaxPendingPerFlow)
+      pending.pop_front();
+    pending.push_back({seq, Simulator::Now().GetSeconds()});
+  }
+
+  void Sample()
+  {
+    for (const Ptr<WifiMacQueue>& queue : m_macQueues)
+    {
+      uint32_t length = queue->GetNPackets();
+      m_macSum += length;
+      m_macMax = std::max(m_macMax, length);
+      m_macSamples++;
+    }
+
+    double expiry = Simulator::Now().GetSeconds() - kMaxBufferTime;
+    uint32_t buffered = 0;
+    for (std::deque<std::pair<uint32_t, double>>& pending : m_pending)
+    {
+      while (!pending.empty() && pending.front().second < expiry)
+        pending.pop_front();
+      buffered += pending.size();
+    }
+    m_bufferSum += buffered;
+    m_bufferMax = std::max(m_bufferMax, buffered);
+    m_bufferSamples++;
+  }
+
+  // Per-node MAC queue mean/max and network-wide routing buffer mean/max
+  // over the samples since the previous call.
+  void TakeInterval(double& macMean, double& macMax, double& bufferMean, double& bufferMax)
+  {
+    macMean = (m_macSamples == 0) ? 0.0 : m_macSum / m_macSamples;
+    macMax = m_macMax;
+    bufferMean = (m_bufferSamples == 0) ? 0.0 : m_bufferSum / m_bufferSamples;
+    bufferMax = m_bufferMax;
+    ResetInterval();
+  }
+
+private:
+  static void MacTx(QueueMonitor* monitor, uint32_t node, Ptr<const Packet> packet)
+  {
+    MyTimestampTag tag;
+    if (!packet->PeekPacketTag(tag) || tag.m_flowId >= monitor->m_nSinks ||
+        node != tag.m_flowId + monitor->m_nSinks)
+      return;
+
+    // Sequence numbers count down, so older packets have larger ones.
+    std::deque<std::pair<uint32_t, double>>& pending = monitor->m_pending[tag.m_flowId];
+    if (pending.empty() || tag.m_seq > pending.front().first)
+      return;
+    while (!pending.empty() && pending.front().first >= tag.m_seq)
+      pending.pop_front();
+  }
+
+  void ResetInterval()
+  {
+    m_macSum = 0.0;
+    m_macMax = 0;
+    m_macSamples = 0;
+    m_bufferSum = 0.0;
+    m_bufferMax = 0;
+    m_bufferSamples = 0;
+  }
+
+  uint32_t m_nSinks;
+  std::vector<Ptr<WifiMacQueue>> m_macQueues;
+  std::vector<std::deque<std::pair<uint32_t, double>>> m_pending; // per flow, oldest first
+
+  double m_macSum;
+  uint32_t m_macMax;
+  uint32_t m_macSamples;
+  double m_bufferSum;
+  uint32_t m_bufferMax;
+  uint32_t m_bufferSamples;
+};
+
+// Measures how long a proactive protocol takes, after startup or an injected
+// topology event, until every pair of nodes connected in the true topology
+// has a working route. The true topology links two nodes when the channel's
+// loss model puts the received power above kLinkThresholdDbm; a route
+// works when following next hops from the source reaches the destination
+// over such links. A phase ends at the first check where all connected
+// pairs are routed.
+class ConvergenceChecker
+{
+public:
+  static constexpr double kCheckInterval = 0.1;
+  // About where DSSS 1 Mb/s control frames stop decoding in ns-3 with the
+  // default 7 dB receiver noise figure.
+  static constexpr double kLinkThresholdDbm = -94.0;
+
+  struct Phase
+  {
+    std::string name;
+    double start;
+    double converged; // seconds after start, negative if never
+  };
+
+  bool Open(const std::string& fileName, bool compress, const NodeContainer& nodes,
+            const Ipv4InterfaceContainer& interfaces, Ptr<PropagationLossModel> loss, double txp)
+  {
+    if (!m_out.Open(fileName, compress))
+      return false;
+    m_out.Write("Time,Phase,ConnectedPairs,RoutedPairs,Coverage\n");
+    m_nodes = nodes;
+    m_loss = loss;
+    m_txp = txp;
+    m_failed.assign(nodes.GetN(), false);
+    for (uint32_t i = 0; i < interfaces.GetN(); ++i)
+      m_nodeByAddress[interfaces.GetAddress(i).Get()] = i;
+    return true;
+  }
+
+  bool IsOpen() const { return m_out.IsOpen(); }
+  bool InPhase() const { return m_active; }
+  const std::vector<Phase>& GetPhases() const { return m_phases; }
+  const std::string& GetPath() const { return m_out.GetPath(); }
+
+  // Starts measuring; an unfinished previous phase stays unconverged.
+  void BeginPhase(const std::string& name)
+  {
+    m_phases.push_back({name, Simulator::Now().GetSeconds(), -1.0});
+    m_active = true;
+  }
+
+  // Removes a node from the true topology.
+  void SetFailed(uint32_t node) { m_failed[node] = true; }
+
+  // tables[i] holds the routes of node i. Returns true once converged.
+  bool Check(const std::vector<std::vector<RouteEntry>>& tables)
+  {
+    uint32_t n = m_nodes.GetN();
+    UpdateLinks();
+    std::vector<int> component = Components();
+
+    std::vector<std::unordered_map<uint32_t, uint32_t>> nextHop(n);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+      for (const RouteEntry& entry : tables[i])
+      {
+        auto dest = m_nodeByAddress.find(entry.destination);
+        auto next = m_nodeByAddress.find(entry.nextHop);
+        if (dest != m_nodeByAddress.end() && next != m_nodeByAddress.end())
+          nextHop[i][dest->second] = next->second;
+      }
+    }
+
+    uint64_t connected = 0;
+    uint64_t routed = 0;
+    for (uint32_t s = 0; s < n; ++s)
+    {
+      for (uint32_t d = 0; d < n; ++d)
+      {
+        if (s == d || m_failed[s] || m_failed[d] || component[s] != component[d])
+          continue;
+        connected++;
+        uint32_t current = s;
+        for (uint32_t hops = 0; current != d && hops < n; ++hops)
+        {
+          auto it = nextHop[current].find(d);
+          if (it == nextHop[current].end() || !Linked(current, it->second))
+            break;
+          current = it->second;
+        }
+        if (current == d)
+          routed++;
+      }
+    }
+
+    double now = Simulator::Now().GetSeconds();
+    double coverage = (connected == 0) ? 1.0 : (double)routed / connected;
+    char line[128];
+    int len = std::snprintf(line, sizeof(line), "%.2f,%s,%llu,%llu,%.4f\n", now,
+                            m_phases.back().name.c_str(), static_cast<unsigned long long>(connected),
+                            static_cast<unsigned long long>(routed), coverage);
+    m_out.Write(line, std::min<int>(len, sizeof(line) - 1));
+
+    if (routed < connected)
+      return false;
+    m_phases.back().converged = now - m_phases.back().start;
+    m_active = false;
+    return true;
+  }
+
+  void Close() { m_out.Close(); }
+
+private:
+  // Evaluates the true topology at the current node positions.
+  void UpdateLinks()
+  {
+    uint32_t n = m_nodes.GetN();
+    m_links.assign(n * n, false);
+    for (uint32_t a = 0; a < n; ++a)
+    {
+      if (m_failed[a])
+        continue;
+      Ptr<MobilityModel> ma = m_nodes.Get(a)->GetObject<MobilityModel>();
+      for (uint32_t b = a + 1; b < n; ++b)
+      {
+        if (m_failed[b])
+          continue;
+        Ptr<MobilityModel> mb = m_nodes.Get(b)->GetObject<MobilityModel>();
+        bool linked = m_loss->CalcRxPower(m_txp, ma, mb) >= kLinkThresholdDbm;
+        m_links[a * n + b] = linked;
+        m_links[b * n + a] = linked;
+      }
+    }
+  }
+
+  bool Linked(uint32_t a, uint32_t b) const { return m_links[a * m_nodes.GetN() + b]; }
+
+  // Connected-component label of every live node in the true topology.
+  std::vector<int> Components() const
+  {
+    uint32_t n = m_nodes.GetN();
+    std::vector<int> component(n, -1);
+    int next = 0;
+    for (uint32_t root = 0; root < n; ++root)
+    {
+      if (component[root] >= 0 || m_failed[root])
+        continue;
+      std::vector<uint32_t> stack{root};
+      component[root] = next;
+      while (!stack.empty())
+      {
+        uint32_t u = stack.back();
+        stack.pop_back();
+        for (uint32_t v = 0; v < n; ++v)
+        {
+          if (component[v] < 0 && !m_failed[v] && Linked(u, v))
+          {
+            component[v] = next;
+            stack.push_back(v);
+          }
+        }
+      }
+      next++;
+    }
+    return component;
+  }
+
+  OutputFile m_out;
+  NodeContainer m_nodes;
+  Ptr<PropagationLossModel> m_loss;
+  double m_txp = 0.0;
+  bool m_active = false;
+  std::vector<bool> m_failed;
+  std::vector<bool> m_links; // n x n, row-major
+  std::unordered_map<uint32_t, uint32_t> m_nodeByAddress;
+  std::vector<Phase> m_phases;
+};
+
+// Abstract link layer for screening runs (--fidelity=screen). The 802.11
+// PHY/MAC is replaced by SimpleNetDevices on this channel. A frame reaches
+// every node within m_range metres after a fixed airtime. Contention is
+// approximated as perfect carrier sense: a transmission waits until its
+// sender's neighbourhood is idle, and then keeps that neighbourhood busy
+// for its airtime. Frames that would wait longer than kMaxDefer (the WiFi
+// MAC queue's default MaxDelay) are dropped. Collisions, hidden terminals
+// and retransmissions are not modelled, which is what makes it cheap.
+class ScreeningChannel : public SimpleChannel
+{
+public:
+  static constexpr double kMaxDefer = 0.5;
+
+  void Configure(double range, Time airtime)
+  {
+    m_range = range;
+    m_airtime = airtime;
+  }
+
+  // Called with every frame handed to the channel, like the WiFi MacTx trace.
+  void SetTxCallback(Callback<void, Ptr<const Packet>> callback) { m_txCallback = callback; }
+
+  uint64_t GetDeferDrops() const { return m_deferDrops; }
+
+  // Distance at which the log-distance model's received power falls to
+  // thresholdDbm.
+  static double RangeFor(Ptr<LogDistancePropagationLossModel> loss, double txp, double thresholdDbm)
+  {
+    DoubleValue exponent;
+    DoubleValue referenceLoss;
+    DoubleValue referenceDistance;
+    loss->GetAttribute("Exponent", exponent);
+    loss->GetAttribute("ReferenceLoss", referenceLoss);
+    loss->GetAttribute("ReferenceDistance", referenceDistance);
+    return referenceDistance.Get() *
+           std::pow(10.0, (txp - thresholdDbm - referenceLoss.Get()) / (10.0 * exponent.Get()));
+  }
+
+  void Add(Ptr<SimpleNetDevice> device) override
+  {
+    SimpleChannel::Add(device);
+    m_devices.push_back(device);
+    m_busyUntil.push_back(Time(0));
+  }
+
+  void Send(Ptr<Packet> p, uint16_t protocol, Mac48Address to, Mac48Address from,
+            Ptr<SimpleNetDevice> sender) override
+  {
+    // Mobility is installed after the devices, so it is looked up on first use.
+    if (m_mobility.size() != m_devices.size())
+    {
+      m_mobility.clear();
+      for (const Ptr<SimpleNetDevice>& device : m_devices)
+        m_mobility.push_back(device->GetNode()->GetObject<MobilityModel>());
+    }
+    if (!m_txCallback.IsNull())
+      m_txCallback(p);
+
+    uint32_t n = m_devices.size();
+    uint32_t s = std::find(m_devices.begin(), m_devices.end(), sender) - m_devices.begin();
+    Vector position = m_mobility[s]->GetPosition();
+    double range2 = m_range * m_range;
+    m_neighbours.clear();
+    for (uint32_t j = 0; j < n; ++j)
+    {
+      if (j != s && CalculateDistanceSquared(position, m_mobility[j]->GetPosition()) <= range2)
+        m_neighbours.push_back(j);
+    }
+
+    Time now = Simulator::Now();
+    Time start = std::max(now, m_busyUntil[s]);
+    if (start - now > Seconds(kMaxDefer))
+    {
+      m_deferDrops++;
+      return;
+    }
+    Time end = start + m_airtime;
+    m_busyUntil[s] = end;
+    for (uint32_t j : m_neighbours)
+    {
+      m_busyUntil[j] = std::max(m_busyUntil[j], end);
+      // Unicast frames are only scheduled at their addressee; the others
+      // would discard them anyway.
+      const Ptr<SimpleNetDevice>& device = m_devices[j];
+      if (!to.IsBroadcast() && !to.IsGroup() && device->GetAddress() != Address(to))
+        continue;
+      Simulator::ScheduleWithContext(device->GetNode()->GetId(), end - now, &SimpleNetDevice::Receive,
+                                     device, p->Copy(), protocol, to, from);
+    }
+  }
+
+private:
+  double m_range = 0.0;
+  Time m_airtime;
+  uint64_t m_deferDrops = 0;
+  Callback<void, Ptr<const Packet>> m_txCallback;
+  std::vector<Ptr<SimpleNetDevice>> m_devices;
+  std::vector<Ptr<MobilityModel>> m_mobility;
+  std::vector<Time> m_busyUntil;
+  std::vector<uint32_t> m_neighbours;
+};
+
+// Building blocks from a map file, chained after the channel's distance
+// loss. Each line of the map is one axis-aligned building,
+// "xMin yMin xMax yMax [wallLossDb]", and '#' starts a comment. Every
+// building wall crossed by the straight line between two nodes adds its
+// wall loss, so a link through a building pays for two walls. The number
+// of walls depends only on geometry, so results are cached per pair of
+// positions snapped to a kQuantum-metre grid. Nodes moving within their
+// cells reuse the cached loss instead of re-testing every building.
+class ObstacleLossModel : public PropagationLossModel
+{
+public:
+  static constexpr double kQuantum = 1.0;
+  static constexpr size_t kMaxCacheEntries = 1 << 20;
+
+  bool Load(const std::string& fileName, double wallLoss)
+  {
+    std::ifstream in(fileName);
+    if (!in)
+      return false;
+    std::string line;
+    while (std::getline(in, line))
+    {
+      line = line.substr(0, line.find('#'));
+      std::istringstream fields(line);
+      Building building;
+      if (!(fields >> building.xMin >> building.yMin >> building.xMax >> building.yMax))
+        continue;
+      if (!(fields >> building.wallLoss))
+        building.wallLoss = wallLoss;
+      if (building.xMin > building.xMax)
+        std::swap(building.xMin, building.xMax);
+      if (building.yMin > building.yMax)
+        std::swap(building.yMin, building.yMax);
+      m_buildings.push_back(building);
+    }
+    return true;
+  }
+
+  size_t GetBuildingCount() const { return m_buildings.size(); }
+  uint64_t GetLookups() const { return m_lookups; }
+  uint64_t GetMisses() const { return m_misses; }
+
+private:
+  struct Building
+  {
+    double xMin, yMin, xMax, yMax;
+    double wallLoss;
+  };
 
-using namespace ns3;
-using namespace dsr;
+  struct PairKey
+  {
+    int32_t ax, ay, bx, by;
+    bool operator==(const PairKey& o) const { return ax == o.ax && ay == o.ay && bx == o.bx && by == o.by; }
+  };
 
-NS_LOG_COMPONENT_DEFINE("RoutingAnalysis");
+  struct PairKeyHash
+  {
+    size_t operator()(const PairKey& k) const
+    {
+      uint64_t a = (static_cast<uint64_t>(static_cast<uint32_t>(k.ax)) << 32) | static_cast<uint32_t>(k.ay);
+      uint64_t b = (static_cast<uint64_t>(static_cast<uint32_t>(k.bx)) << 32) | static_cast<uint32_t>(k.by);
+      return std::hash<uint64_t>()(a * 0x9e3779b97f4a7c15ULL ^ b);
+    }
+  };
 
-class MyTimestampTag : public Tag
+  double DoCalcRxPower(double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const override
+  {
+    if (m_buildings.empty())
+      return txPowerDbm;
+    Vector pa = a->GetPosition();
+    Vector pb = b->GetPosition();
+    PairKey key{static_cast<int32_t>(std::floor(pa.x / kQuantum)), static_cast<int32_t>(std::floor(pa.y / kQuantum)),
+                static_cast<int32_t>(std::floor(pb.x / kQuantum)), static_cast<int32_t>(std::floor(pb.y / kQuantum))};
+    // The loss is symmetric, so each unordered pair is stored once.
+    if (std::tie(key.bx, key.by) < std::tie(key.ax, key.ay))
+      key = {key.bx, key.by, key.ax, key.ay};
+
+    m_lookups++;
+    auto it = m_cache.find(key);
+    if (it == m_cache.end())
+    {
+      m_misses++;
+      if (m_cache.size() >= kMaxCacheEntries)
+        m_cache.clear();
+      // Walls are tested between the cell centres, so a cached value never
+      // depends on which position inside the cells filled it.
+      double loss = WallLoss((key.ax + 0.5) * kQuantum, (key.ay + 0.5) * kQuantum,
+                             (key.bx + 0.5) * kQuantum, (key.by + 0.5) * kQuantum);
+      it = m_cache.emplace(key, loss).first;
+    }
+    return txPowerDbm - it->second;
+  }
+
+  int64_t DoAssignStreams(int64_t /* stream */) override { return 0; }
+
+  double WallLoss(double x1, double y1, double x2, double y2) const
+  {
+    double loss = 0.0;
+    for (const Building& building : m_buildings)
+      loss += WallsCrossed(building, x1, y1, x2, y2) * building.wallLoss;
+    return loss;
+  }
+
+  // Clips the segment to the building (Liang-Barsky). It crosses a wall
+  // where it enters and where it leaves, unless that end is inside; a
+  // segment that only grazes an edge or corner crosses none.
+  static uint32_t WallsCrossed(const Building& building, double x1, double y1, double x2, double y2)
+  {
+    const double p[4] = {x1 - x2, x2 - x1, y1 - y2, y2 - y1};
+    const double q[4] = {x1 - building.xMin, building.xMax - x1, y1 - building.yMin, building.yMax - y1};
+    double enter = 0.0;
+    double leave = 1.0;
+    for (int i = 0; i < 4; ++i)
+    {
+      if (p[i] == 0.0)
+      {
+        if (q[i] < 0.0)
+          return 0;
+        continue;
+      }
+      double t = q[i] / p[i];
+      if (p[i] < 0.0)
+        enter = std::max(enter, t);
+      else
+        leave = std::min(leave, t);
+    }
+    if (enter >= leave)
+      return 0;
+    return (enter > 0.0) + (leave < 1.0);
+  }
+
+  std::vector<Building> m_buildings;
+  mutable std::unordered_map<PairKey, double, PairKeyHash> m_cache;
+  mutable uint64_t m_lookups = 0;
+  mutable uint64_t m_misses = 0;
+};
+
+// Time-correlated small-scale fading on top of a mean loss model, which
+// it wraps so that the mean topology stays available to other users. Each
+// link's gain is the mean power of m complex Gaussian taps, which makes it
+// Nakagami-m distributed (m = 1 is Rayleigh). Every tap follows a
+// first-order Gauss-Markov process with correlation exp(-dt / coherence)
+// between two uses of the link. State is created only for links whose
+// mean power is within kFadeMarginDb of the receiver sensitivity, and a
+// link idle for kEvictCoherences coherence times is evicted: its next
+// sample would be practically independent anyway, so it starts again from
+// the stationary distribution.
+class FadingLossModel : public PropagationLossModel
 {
 public:
-  Time m_timestamp;
+  static constexpr uint32_t kMaxM = 8;
+  static constexpr double kEvictCoherences = 5.0;
+  // YansWifiPhy's default RxSensitivity, and a margin a Rayleigh fade
+  // exceeds with probability e^-10.
+  static constexpr double kSensitivityDbm = -101.0;
+  static constexpr double kFadeMarginDb = 10.0;
 
-  static TypeId GetTypeId()
+  FadingLossModel() : m_normal(CreateObject<NormalRandomVariable>())
   {
-    static TypeId tid = TypeId("MyTimestampTag")
-                            .SetParent<Tag>()
-                            .AddConstructor<MyTimestampTag>();
-    return tid;
+    m_normal->SetAttribute("Mean", DoubleValue(0.0));
+    m_normal->SetAttribute("Variance", DoubleValue(0.5));
   }
 
-  virtual TypeId GetInstanceTypeId() const override { return GetTypeId(); }
-  virtual uint32_t GetSerializedSize() const override { return 8; }
-  
-  virtual void Serialize(TagBuffer i) const override
+  void Configure(Ptr<PropagationLossModel> mean, uint32_t m, double coherence)
   {
-    i.WriteDouble(m_timestamp.GetSeconds());
+    m_mean = mean;
+    m_m = std::min(std::max(m, 1u), kMaxM);
+    m_coherence = coherence;
   }
 
-  virtual void Deserialize(TagBuffer i) override
+  uint64_t GetCreated() const { return m_created; }
+  uint64_t GetEvicted() const { return m_evicted; }
+  size_t GetPeakLinks() const { return m_peakLinks; }
+
+private:
+  struct LinkState
   {
-    m_timestamp = Seconds(i.ReadDouble());
+    double updated;
+    std::array<double, 2 * kMaxM> taps; // re, im per tap; E|h|^2 = 1
+  };
+
+  using LinkKey = std::pair<const MobilityModel*, const MobilityModel*>;
+
+  struct LinkKeyHash
+  {
+    size_t operator()(const LinkKey& k) const
+    {
+      return std::hash<const void*>()(k.first) * 31 ^ std::hash<const void*>()(k.second);
+    }
+  };
+
+  double DoCalcRxPower(double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const override
+  {
+    double rxPowerDbm = m_mean->CalcRxPower(txPowerDbm, a, b);
+    if (rxPowerDbm < kSensitivityDbm - kFadeMarginDb)
+      return rxPowerDbm;
+
+    double now = Simulator::Now().GetSeconds();
+    double idle = kEvictCoherences * m_coherence;
+    if (now - m_lastSweep >= idle)
+    {
+      for (auto it = m_links.begin(); it != m_links.end();)
+      {
+        if (now - it->second.updated >= idle)
+        {
+          it = m_links.erase(it);
+          m_evicted++;
+        }
+        else
+          ++it;
+      }
+      m_lastSweep = now;
+    }
+
+    // Links are reciprocal: both directions share one state.
+    LinkKey key(PeekPointer(a), PeekPointer(b));
+    if (key.second < key.first)
+      std::swap(key.first, key.second);
+
+    auto it = m_links.find(key);
+    if (it == m_links.end() || now - it->second.updated >= idle)
+    {
+      LinkState& state = m_links[key];
+      for (uint32_t i = 0; i < 2 * m_m; ++i)
+        state.taps[i] = m_normal->GetValue();
+      state.updated = now;
+      m_created++;
+      m_peakLinks = std::max(m_peakLinks, m_links.size());
+      it = m_links.find(key);
+    }
+    else if (now > it->second.updated)
+    {
+      double rho = std::exp(-(now - it->second.updated) / m_coherence);
+      double innovation = std::sqrt(1.0 - rho * rho);
+      for (uint32_t i = 0; i < 2 * m_m; ++i)
+        it->second.taps[i] = rho * it->second.taps[i] + innovation * m_normal->GetValue();
+      it->second.updated = now;
+    }
+
+    double gain = 0.0;
+    for (uint32_t i = 0; i < 2 * m_m; ++i)
+      gain += it->second.taps[i] * it->second.taps[i];
+    gain /= m_m;
+    return rxPowerDbm + 10.0 * std::log10(std::max(gain, 1e-12));
   }
 
-  virtual void Print(std::ostream& os) const override
+  int64_t DoAssignStreams(int64_t stream) override
   {
-    os << "Timestamp=" << m_timestamp.GetSeconds();
+    m_normal->SetStream(stream);
+    return 1 + m_mean->AssignStreams(stream + 1);
   }
 
-  void SetTimestamp(Time time) { m_timestamp = time; }
-  Time GetTimestamp() const { return m_timestamp; }
+  Ptr<PropagationLossModel> m_mean;
+  Ptr<NormalRandomVariable> m_normal;
+  uint32_t m_m = 1;
+  double m_coherence = 0.05;
+  mutable std::unordered_map<LinkKey, LinkState, LinkKeyHash> m_links;
+  mutable double m_lastSweep = 0.0;
+  mutable uint64_t m_created = 0;
+  mutable uint64_t m_evicted = 0;
+  mutable size_t m_peakLinks = 0;
+};
+
+// Fork-join pool for splitting one loop over worker threads. Run() hands
+// every thread one contiguous chunk and returns once all are done; the
+// calling thread takes the first chunk. Jobs arrive once per channel
+// transmission, so idle workers spin for kSpinRounds yields before
+// sleeping. Chunks start on multiples of kAlign elements, so a vectorised
+// loop splits into the same vector and remainder iterations it would run
+// unsplit, and every element is computed by the same code on any thread
+// count.
+class ForkJoinPool
+{
+public:
+  static constexpr int kSpinRounds = 2000;
+  static constexpr size_t kAlign = 8;
+
+  ~ForkJoinPool() { Stop(); }
+
+  // threads counts the calling thread; 1 runs everything inline.
+  void Start(uint32_t threads)
+  {
+    Stop();
+    m_stopping = false;
+    for (uint32_t i = 1; i < threads; ++i)
+      m_workers.emplace_back(&ForkJoinPool::WorkerLoop, this, i);
+  }
+
+  void Stop()
+  {
+    if (m_workers.empty())
+      return;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+      m_generation.fetch_add(1, std::memory_order_release);
+    }
+    m_wake.notify_all();
+    for (std::thread& worker : m_workers)
+      worker.join();
+    m_workers.clear();
+  }
+
+  uint32_t GetThreads() const { return m_workers.size() + 1; }
+
+  void Run(size_t n, const std::function<void(size_t, size_t)>& job)
+  {
+    m_job = &job;
+    m_n = n;
+    m_pending.store(m_workers.size(), std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_generation.fetch_add(1, std::memory_order_release);
+    }
+    m_wake.notify_all();
+    RunChunk(0);
+    while (m_pending.load(std::memory_order_acquire) != 0)
+      std::this_thread::yield();
+  }
+
+private:
+  void RunChunk(uint32_t index)
+  {
+    size_t threads = m_workers.size() + 1;
+    size_t chunk = (m_n + threads - 1) / threads;
+    chunk = (chunk + kAlign - 1) / kAlign * kAlign;
+    size_t begin = std::min(m_n, index * chunk);
+    size_t end = std::min(m_n, begin + chunk);
+    if (begin < end)
+      (*m_job)(begin, end);
+  }
+
+  void WorkerLoop(uint32_t index)
+  {
+    uint64_t seen = 0;
+    for (;;)
+    {
+      uint64_t generation;
+      int spins = 0;
+      while ((generation = m_generation.load(std::memory_order_acquire)) == seen)
+      {
+        if (++spins < kSpinRounds)
+        {
+          std::this_thread::yield();
+          continue;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait(lock, [&] { return m_generation.load(std::memory_order_acquire) != seen; });
+      }
+      seen = generation;
+      if (m_stopping)
+        return;
+      RunChunk(index);
+      m_pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+  }
+
+  std::vector<std::thread> m_workers;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::atomic<uint64_t> m_generation{0};
+  std::atomic<size_t> m_pending{0};
+  const std::function<void(size_t, size_t)>* m_job = nullptr;
+  size_t m_n = 0;
+  bool m_stopping = false;
+};
+
+// Log-distance loss from one transmitter to every node, computed in one
+// pass over structure-of-arrays positions. The channel asks for the loss
+// one receiver at a time, so the first query of a transmission fills the
+// whole row and the rest of that transmission reads it back. Motion is
+// piecewise linear between course changes (true for the random waypoint
+// model), so positions are stored as origin, velocity and time and only
+// refreshed from the CourseChange trace. The row loop has no calls or
+// branches (BatchLog10 replaces std::log10) and auto-vectorises at -O3.
+// Rows of at least kMinParallelNodes can be split over a ForkJoinPool;
+// the channel still schedules receptions one receiver at a time in its
+// own order, so only the arithmetic moves off the simulator thread.
+// With validation on, every query is also computed through the scalar
+// model, whose value is returned, and the largest difference is kept.
+class BatchLossModel : public PropagationLossModel
+{
+public:
+  // Below this, waking the workers costs more than the row itself.
+  static constexpr size_t kMinParallelNodes = 256;
+
+  void Configure(Ptr<LogDistancePropagationLossModel> scalar, bool validate)
+  {
+    DoubleValue exponent;
+    DoubleValue referenceLoss;
+    DoubleValue referenceDistance;
+    scalar->GetAttribute("Exponent", exponent);
+    scalar->GetAttribute("ReferenceLoss", referenceLoss);
+    scalar->GetAttribute("ReferenceDistance", referenceDistance);
+    // 10 n log10(d / d0) = 5 n log10(d^2 / d0^2), so no square root is needed.
+    m_slope = 5.0 * exponent.Get();
+    m_referenceLoss = referenceLoss.Get();
+    m_invReferenceDistance2 = 1.0 / (referenceDistance.Get() * referenceDistance.Get());
+    m_scalar = scalar;
+    m_validate = validate;
+  }
+
+  // Must be called once mobility is installed.
+  void Attach(const NodeContainer& nodes)
+  {
+    uint32_t n = nodes.GetN();
+    for (std::vector<double>* column : {&m_x, &m_y, &m_z, &m_vx, &m_vy, &m_vz, &m_t0, &m_row})
+      column->assign(n, 0.0);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+      Ptr<MobilityModel> mobility = nodes.Get(i)->GetObject<MobilityModel>();
+      m_index[PeekPointer(mobility)] = i;
+      CourseChanged(this, i, mobility);
+      mobility->TraceConnectWithoutContext("CourseChange",
+                                           MakeBoundCallback(&BatchLossModel::CourseChanged, this, i));
+    }
+  }
+
+  void SetThreads(uint32_t threads) { m_pool.Start(threads); }
+  uint32_t GetThreads() const { return m_pool.GetThreads(); }
+
+  uint64_t GetQueries() const { return m_queries; }
+  uint64_t GetRows() const { return m_rows; }
+  uint64_t GetParallelRows() const { return m_parallelRows; }
+  double GetMaxError() const { return m_maxError; }
+
+  // log10 of a positive double without calls or branches. x = m 2^k with
+  // m in [sqrt(1/2), sqrt(2)), and ln m = 2 atanh(s) with s = (m-1)/(m+1)
+  // and |s| < 0.172, summed as an odd series to s^15 (error < 1e-13).
+  static double BatchLog10(double x)
+  {
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    int32_t k = static_cast<int32_t>((bits - 0x3fe6a09e667f3bcdULL) >> 32) >> 20;
+    uint64_t mantissaBits = bits - (static_cast<uint64_t>(static_cast<int64_t>(k)) << 52);
+    double m;
+    std::memcpy(&m, &mantissaBits, sizeof(m));
+    double s = (m - 1.0) / (m + 1.0);
+    double s2 = s * s;
+    double series =
+        1.0 + s2 * (1.0 / 3 + s2 * (1.0 / 5 + s2 * (1.0 / 7 + s2 * (1.0 / 9 + s2 * (1.0 / 11 + s2 * (1.0 / 13 + s2 / 15))))));
+    return (k * 0.69314718055994530942 + 2.0 * s * series) * 0.43429448190325182765;
+  }
+
+private:
+  static void CourseChanged(BatchLossModel* model, uint32_t i, Ptr<const MobilityModel> mobility)
+  {
+    Vector position = mobility->GetPosition();
+    Vector velocity = mobility->GetVelocity();
+    model->m_x[i] = position.x;
+    model->m_y[i] = position.y;
+    model->m_z[i] = position.z;
+    model->m_vx[i] = velocity.x;
+    model->m_vy[i] = velocity.y;
+    model->m_vz[i] = velocity.z;
+    model->m_t0[i] = Simulator::Now().GetSeconds();
+    model->m_epoch++;
+  }
+
+  void DoDispose() override
+  {
+    m_pool.Stop();
+    PropagationLossModel::DoDispose();
+  }
+
+  void FillRow(uint32_t sender, double now) const
+  {
+    double senderDt = now - m_t0[sender];
+    double sx = m_x[sender] + m_vx[sender] * senderDt;
+    double sy = m_y[sender] + m_vy[sender] * senderDt;
+    double sz = m_z[sender] + m_vz[sender] * senderDt;
+    if (m_pool.GetThreads() == 1 || m_row.size() < kMinParallelNodes)
+    {
+      FillRange(0, m_row.size(), now, sx, sy, sz);
+      return;
+    }
+    std::function<void(size_t, size_t)> job = [this, now, sx, sy, sz](size_t begin, size_t end) {
+      FillRange(begin, end, now, sx, sy, sz);
+    };
+    m_pool.Run(m_row.size(), job);
+    m_parallelRows++;
+  }
+
+  // Loss from the transmitter at (sx, sy, sz) to nodes [begin, end).
+  void FillRange(size_t begin, size_t end, double now, double sx, double sy, double sz) const
+  {
+    const double* x = m_x.data();
+    const double* y = m_y.data();
+    const double* z = m_z.data();
+    const double* vx = m_vx.data();
+    const double* vy = m_vy.data();
+    const double* vz = m_vz.data();
+    const double* t0 = m_t0.data();
+    double* row = m_row.data();
+    const double referenceLoss = m_referenceLoss;
+    const double halfSlope = 0.5 * m_slope;
+    const double invReferenceDistance2 = m_invReferenceDistance2;
+    for (size_t j = begin; j < end; ++j)
+    {
+      double dt = now - t0[j];
+      double dx = x[j] + vx[j] * dt - sx;
+      double dy = y[j] + vy[j] * dt - sy;
+      double dz = z[j] + vz[j] * dt - sz;
+      double decades = BatchLog10((dx * dx + dy * dy + dz * dz) * invReferenceDistance2);
+      // max(decades, 0) without a branch: no extra loss inside d0.
+      row[j] = referenceLoss + halfSlope * (decades + std::fabs(decades));
+    }
+  }
+
+  double DoCalcRxPower(double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const override
+  {
+    auto ia = m_index.find(PeekPointer(a));
+    auto ib = m_index.find(PeekPointer(b));
+    if (ia == m_index.end() || ib == m_index.end())
+      return m_scalar->CalcRxPower(txPowerDbm, a, b);
+
+    m_queries++;
+    double now = Simulator::Now().GetSeconds();
+    if (ia->second != m_rowSender || now != m_rowTime || m_epoch != m_rowEpoch)
+    {
+      FillRow(ia->second, now);
+      m_rowSender = ia->second;
+      m_rowTime = now;
+      m_rowEpoch = m_epoch;
+      m_rows++;
+    }
+    double rxPowerDbm = txPowerDbm - m_row[ib->second];
+    if (!m_validate)
+      return rxPowerDbm;
+    double scalarDbm = m_scalar->CalcRxPower(txPowerDbm, a, b);
+    m_maxError = std::max(m_maxError, std::fabs(rxPowerDbm - scalarDbm));
+    return scalarDbm;
+  }
+
+  int64_t DoAssignStreams(int64_t /* stream */) override { return 0; }
+
+  Ptr<LogDistancePropagationLossModel> m_scalar;
+  bool m_validate = false;
+  double m_slope = 0.0;
+  double m_referenceLoss = 0.0;
+  double m_invReferenceDistance2 = 1.0;
+  std::unordered_map<const MobilityModel*, uint32_t> m_index;
+  std::vector<double> m_x, m_y, m_z, m_vx, m_vy, m_vz, m_t0; // state at the last course change
+  uint64_t m_epoch = 0;                                      // bumped on every course change
+
+  mutable std::vector<double> m_row; // loss in dB from m_rowSender to every node
+  mutable uint32_t m_rowSender = std::numeric_limits<uint32_t>::max();
+  mutable double m_rowTime = -1.0;
+  mutable uint64_t m_rowEpoch = 0;
+  mutable uint64_t m_queries = 0;
+  mutable uint64_t m_rows = 0;
+  mutable uint64_t m_parallelRows = 0;
+  mutable double m_maxError = 0.0;
+  mutable ForkJoinPool m_pool;
 };
 
+// Parses "all" or a comma-separated list of node ids and ranges ("0,3,5-8").
+static bool
+ParseNodeList(const std::string& spec, uint32_t nNodes, std::vector<uint32_t>& nodes)
+{
+  nodes.clear();
+  if (spec == "all")
+  {
+    for (uint32_t i = 0; i < nNodes; ++i)
+      nodes.push_back(i);
+    return true;
+  }
+
+  std::stringstream ss(spec);
+  std::string item;
+  while (std::getline(ss, item, ','))
+  {
+    if (item.empty())
+      continue;
+    size_t dash = item.find('-');
+    try
+    {
+      uint32_t first = std::stoul(item.substr(0, dash));
+      uint32_t last = (dash == std::string::npos) ? first : std::stoul(item.substr(dash + 1));
+      if (last < first || last >= nNodes)
+        return false;
+      for (uint32_t i = first; i <= last; ++i)
+        nodes.push_back(i);
+    }
+    catch (const std::exception&)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
 class RoutingExperiment
 {
 public:
@@ -71,37 +2431,117 @@ public:
 
 private:
   void SetupTraffic();
+  template <typename... Metrics>
   void ReceivePacket(Ptr<Socket> socket);
-  void SendPacket(Ptr<Socket> socket, uint32_t pktSize, uint32_t numPkts, Time interval);
+  Callback<void, Ptr<Socket>> MakeReceiveCallback();
+  void SendPacket(Ptr<Socket> socket, uint32_t flowId, uint32_t pktSize, uint32_t numPkts, Time interval);
   void CheckThroughput();
+  void RollupTick();
+  void SampleQueues();
+  void CheckConvergence();
+  void FailNode();
   void MacTxCallback(Ptr<const Packet> packet);
+  void ReportProgress();
+  void StartWatchdog();
+  void StopWatchdog();
+  void WallBudgetExpired();
+  void SetupPcapCapture(const NetDeviceContainer& devices);
+  void CollectRoutes(Ptr<Node> node, std::vector<RouteEntry>& entries);
+  void TakeRoutingSnapshot();
   void PrintFinalStatistics();
+  void WriteRunSummary(const std::string& animFileName);
 
   uint32_t m_port;
   uint32_t m_bytesTotal;
   uint32_t m_packetsReceived;
   uint32_t m_packetsSent;
-  double m_totalDelay;
-  uint32_t m_delaySamples;
   uint32_t m_routingPackets;
-  double m_minDelay;
-  double m_maxDelay;
   uint32_t m_packetsDropped;
+  MetricState m_metrics;
 
   std::string m_CSVfileName;
   int m_nSinks;
   std::string m_protocolName;
+  std::string m_outputPrefix; // <protocol>, or <protocol>-SCREEN for screening runs
   double m_txp;
   int m_nWifis;
   double m_totalTime;
   std::string m_rate;
   double m_nodeSpeed;
   double m_pauseTime;
+  bool m_delayMetrics;
+  std::string m_liveSocket;
+  double m_progressInterval;
+  double m_wallBudget;
+  bool m_truncated;
+  std::string m_codeVersion;
+  std::string m_verbosity;
+  std::string m_logFile;
+  bool m_compress;
+  std::string m_pcapNodes;
+  double m_pcapStart;
+  double m_pcapStop;
+  uint32_t m_pcapSnapLen;
+  double m_pcapTriggerPdr;
+  double m_pcapTriggerHold;
+  PcapCapture m_pcap;
+  double m_rtSnapshotInterval;
+  RoutingSnapshotWriter m_rtSnapshots;
+  bool m_rollups;
+  RollupEngine m_rollupEngine;
+  bool m_floodMetrics;
+  FloodTracker m_floods;
+  bool m_loopDetection;
+  LoopDetector m_loops;
+  size_t m_loopColumn;
+  bool m_queueMonitor;
+  QueueMonitor m_queues;
+  size_t m_queueColumn;
+  double m_lastDelayTotal;
+  uint32_t m_lastDelaySamples;
+  bool m_convergence;
+  ConvergenceChecker m_convergenceChecker;
+  EventId m_convergenceEvent;
+  int m_failNode;
+  double m_failAt;
+  std::string m_fidelity;
+  double m_screenRange;
+  double m_screenAirtime;
+  Ptr<ScreeningChannel> m_screenChannel;
+  std::string m_obstacles;
+  double m_wallLoss;
+  Ptr<ObstacleLossModel> m_obstacleModel;
+  std::string m_fading;
+  uint32_t m_nakagamiM;
+  double m_fadingCoherence;
+  Ptr<FadingLossModel> m_fadingModel;
+  std::string m_lossKernel;
+  uint32_t m_lossThreads;
+  Ptr<BatchLossModel> m_batchLoss;
+  uint32_t m_lastIntervalSent;
+  uint32_t m_lastIntervalReceived;
+  RunLogger m_log;
+
+  std::chrono::steady_clock::time_point m_wallStart;
+  std::chrono::steady_clock::time_point m_lastProgressWall;
+  double m_lastProgressSim;
+  uint64_t m_lastProgressEvents;
+  // Captured when Simulator::Run() returns, for the summary written after
+  // Simulator::Destroy().
+  double m_runWallSeconds;
+  double m_simulatedSeconds;
+  uint64_t m_eventCount;
+  std::thread m_watchdog;
+  std::mutex m_watchdogMutex;
+  std::condition_variable m_watchdogWake;
+  bool m_runFinished;
 
   NodeContainer m_nodes;
   Ipv4InterfaceContainer m_interfaces;
   std::map<Ptr<Socket>, EventId> m_socketEvents;
   std::vector<Ptr<Socket>> m_sockets;
+
+  MetricsWriter m_writer;
 };
 
 RoutingExperiment::RoutingExperiment()
@@ -109,26 +2549,69 @@ RoutingExperiment::RoutingExperiment()
       m_bytesTotal(0),
       m_packetsReceived(0),
       m_packetsSent(0),
-      m_totalDelay(0.0),
-      m_delaySamples(0),
       m_routingPackets(0),
-      m_minDelay(std::numeric_limits<double>::max()),
-      m_maxDelay(0.0),
       m_packetsDropped(0),
       m_CSVfileName("routing-analysis.csv"),
       m_nSinks(5),
       m_protocolName("AODV"),
+      m_outputPrefix("AODV"),
       m_txp(25.0),
       m_nWifis(25),
       m_totalTime(200.0),
       m_rate("2048bps"),
       m_nodeSpeed(2.0),
-      m_pauseTime(5.0)
+      m_pauseTime(5.0),
+      m_delayMetrics(true),
+      m_liveSocket(""),
+      m_progressInterval(10.0),
+      m_wallBudget(0.0),
+      m_truncated(false),
+      m_codeVersion(MANET_CODE_VERSION),
+      m_verbosity("verbose"),
+      m_logFile(""),
+      m_compress(false),
+      m_pcapNodes(""),
+      m_pcapStart(0.0),
+      m_pcapStop(0.0),
+      m_pcapSnapLen(65535),
+      m_pcapTriggerPdr(0.0),
+      m_pcapTriggerHold(5.0),
+      m_rtSnapshotInterval(0.0),
+      m_rollups(false),
+      m_floodMetrics(false),
+      m_loopDetection(false),
+      m_loopColumn(0),
+      m_queueMonitor(false),
+      m_queueColumn(0),
+      m_lastDelayTotal(0.0),
+      m_lastDelaySamples(0),
+      m_convergence(false),
+      m_failNode(-1),
+      m_failAt(0.0),
+      m_fidelity("full"),
+      m_screenRange(0.0),
+      m_screenAirtime(0.001),
+      m_obstacles(""),
+      m_wallLoss(12.0),
+      m_fading("none"),
+      m_nakagamiM(2),
+      m_fadingCoherence(0.05),
+      m_lossKernel("scalar"),
+      m_lossThreads(1),
+      m_lastIntervalSent(0),
+      m_lastIntervalReceived(0),
+      m_lastProgressSim(0.0),
+      m_lastProgressEvents(0),
+      m_runWallSeconds(0.0),
+      m_simulatedSeconds(0.0),
+      m_eventCount(0),
+      m_runFinished(false)
 {
 }
 
 RoutingExperiment::~RoutingExperiment()
 {
+  StopWatchdog();
   for (auto& pair : m_socketEvents)
   {
     if (pair.second.IsRunning())
@@ -136,102 +2619,429 @@ RoutingExperiment::~RoutingExperiment()
       Simulator::Cancel(pair.second);
     }
   }
-  
-  for (auto& socket : m_sockets)
+  
+  for (auto& socket : m_sockets)
+  {
+    if (socket)
+    {
+      socket->Close();
+    }
+  }
+}
+
+template <typename... Metrics>
+void RoutingExperiment::ReceivePacket(Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  Address from;
+
+  while ((packet = socket->RecvFrom(from)))
+  {
+    if (packet->GetSize() > 0)
+    {
+      m_bytesTotal += packet->GetSize();
+      m_packetsReceived++;
+
+      (Metrics::OnReceive(packet, m_metrics), ...);
+    }
+  }
+}
+
+Callback<void, Ptr<Socket>> RoutingExperiment::MakeReceiveCallback()
+{
+  if (m_delayMetrics && m_rollups)
+  {
+    return MakeCallback(&RoutingExperiment::ReceivePacket<DelayMetric, RollupMetric>, this);
+  }
+  if (m_delayMetrics)
+  {
+    return MakeCallback(&RoutingExperiment::ReceivePacket<DelayMetric>, this);
+  }
+  if (m_rollups)
+  {
+    return MakeCallback(&RoutingExperiment::ReceivePacket<RollupMetric>, this);
+  }
+  return MakeCallback(&RoutingExperiment::ReceivePacket<>, this);
+}
+
+void RoutingExperiment::SendPacket(Ptr<Socket> socket, uint32_t flowId, uint32_t pktSize, uint32_t numPkts, Time interval)
+{
+  if (numPkts > 0 && Simulator::Now().GetSeconds() < m_totalTime - 1.0)
+  {
+    // A fresh packet per send, deliberately. The payload is a zero-filled
+    // virtual area, so no payload bytes are allocated. Copies of a shared
+    // template would keep the template's UID, and the AODV, DSR and DSDV
+    // route-discovery queues drop packets whose UID and destination are
+    // already queued.
+    Ptr<Packet> packet = Create<Packet>(pktSize);
+
+    // The remaining-packet count doubles as a sequence number unique in the flow.
+    MyTimestampTag tag;
+    tag.SetTimestamp(Simulator::Now());
+    tag.SetPacketId(flowId, numPkts);
+    packet->AddPacketTag(tag);
+
+    int bytesSent = socket->Send(packet);
+    if (bytesSent > 0)
+    {
+      m_packetsSent++;
+      if (m_rollups)
+        m_rollupEngine.Add(RollupEngine::SENT, bytesSent);
+      if (m_queues.IsEnabled())
+        m_queues.OnSend(flowId, numPkts);
+    }
+    else
+    {
+      m_packetsDropped++;
+    }
+
+    m_socketEvents[socket] = Simulator::Schedule(interval, 
+                                                  &RoutingExperiment::SendPacket, 
+                                                  this, 
+                                                  socket, 
+                                                  flowId, 
+                                                  pktSize, 
+                                                  numPkts - 1, 
+                                                  interval);
+  }
+}
+
+void RoutingExperiment::CheckThroughput()
+{
+  double kbs = (m_bytesTotal * 8.0) / 1000.0;
+  m_bytesTotal = 0;
+
+  double pdr = (m_packetsSent == 0) ? 0.0 : (double)m_packetsReceived / m_packetsSent;
+  // NaN (written as "nan") rather than a zero that reads as a real delay.
+  double avgDelay = m_delayMetrics ? m_metrics.delay.Mean() : std::numeric_limits<double>::quiet_NaN();
+
+  MetricsRecord record;
+  record.time = Simulator::Now().GetSeconds();
+  record.throughputKbps = kbs;
+  record.packetsReceived = m_packetsReceived;
+  record.pdr = pdr;
+  record.avgDelay = avgDelay;
+  record.routingPackets = m_routingPackets;
+  if (m_loops.IsEnabled())
+  {
+    uint32_t loopedPackets, extraTx;
+    m_loops.TakeInterval(loopedPackets, extraTx);
+    record.extra[m_loopColumn] = loopedPackets;
+    record.extra[m_loopColumn + 1] = extraTx;
+  }
+  if (m_queues.IsEnabled())
+  {
+    double macMean, macMax, bufferMean, bufferMax;
+    m_queues.TakeInterval(macMean, macMax, bufferMean, bufferMax);
+    record.extra[m_queueColumn] = macMean;
+    record.extra[m_queueColumn + 1] = macMax;
+    record.extra[m_queueColumn + 2] = bufferMean;
+    record.extra[m_queueColumn + 3] = bufferMax;
+
+    // Delay of the packets received in this interval, to set against the
+    // queue columns; AvgDelay is cumulative.
+    const DelayStats& delay = m_metrics.delay;
+    uint32_t samples = delay.samples - m_lastDelaySamples;
+    record.extra[m_queueColumn + 4] = (samples == 0 || !m_delayMetrics) ? std::numeric_limits<double>::quiet_NaN()
+                                                     : (delay.total - m_lastDelayTotal) / samples;
+    m_lastDelayTotal = delay.total;
+    m_lastDelaySamples = delay.samples;
+  }
+  m_writer.Push(record);
+
+  // Interval PDR drives the capture trigger; the CSV keeps the cumulative one.
+  uint32_t intervalSent = m_packetsSent - m_lastIntervalSent;
+  uint32_t intervalReceived = m_packetsReceived - m_lastIntervalReceived;
+  m_lastIntervalSent = m_packetsSent;
+  m_lastIntervalReceived = m_packetsReceived;
+  if (m_pcapTriggerPdr > 0.0 && intervalSent > 0 &&
+      (double)intervalReceived / intervalSent < m_pcapTriggerPdr)
+  {
+    m_pcap.Arm(m_pcapTriggerHold);
+  }
+
+ // m_packetsReceived = 0;
+  
+  if (Simulator::Now().GetSeconds() < m_totalTime - 1.0)
+  {
+    Simulator::Schedule(Seconds(1.0), &RoutingExperiment::CheckThroughput, this);
+  }
+}
+
+void RoutingExperiment::RollupTick()
+{
+  double now = Simulator::Now().GetSeconds();
+  m_rollupEngine.Tick(now);
+  if (now + 0.1 < m_totalTime)
+  {
+    Simulator::Schedule(MilliSeconds(100), &RoutingExperiment::RollupTick, this);
+  }
+}
+
+void RoutingExperiment::SampleQueues()
+{
+  m_queues.Sample();
+  if (Simulator::Now().GetSeconds() + QueueMonitor::kSamplePeriod < m_totalTime)
+  {
+    Simulator::Schedule(Seconds(QueueMonitor::kSamplePeriod), &RoutingExperiment::SampleQueues, this);
+  }
+}
+
+void RoutingExperiment::CheckConvergence()
+{
+  std::vector<std::vector<RouteEntry>> tables(m_nodes.GetN());
+  for (uint32_t i = 0; i < m_nodes.GetN(); ++i)
+  {
+    CollectRoutes(m_nodes.Get(i), tables[i]);
+  }
+
+  if (m_convergenceChecker.Check(tables))
+  {
+    const ConvergenceChecker::Phase& phase = m_convergenceChecker.GetPhases().back();
+    RUN_LOG(m_log, SUMMARY, ">>> Routes converged " << phase.converged << " s after " << phase.name);
+    return;
+  }
+  if (Simulator::Now().GetSeconds() + ConvergenceChecker::kCheckInterval < m_totalTime)
   {
-    if (socket)
-    {
-      socket->Close();
-    }
+    m_convergenceEvent = Simulator::Schedule(Seconds(ConvergenceChecker::kCheckInterval),
+                                             &RoutingExperiment::CheckConvergence, this);
   }
 }
 
-void RoutingExperiment::ReceivePacket(Ptr<Socket> socket)
+// Takes the failed node's WiFi interface (index 1, after loopback) down.
+void RoutingExperiment::FailNode()
 {
-  Ptr<Packet> packet;
-  Address from;
+  m_nodes.Get(m_failNode)->GetObject<Ipv4>()->SetDown(1);
+  RUN_LOG(m_log, SUMMARY, ">>> Node " << m_failNode << " failed at t=" << Simulator::Now().GetSeconds() << " s");
 
-  while ((packet = socket->RecvFrom(from)))
+  if (m_convergenceChecker.IsOpen())
   {
-    if (packet->GetSize() > 0)
+    m_convergenceChecker.SetFailed(m_failNode);
+    m_convergenceChecker.BeginPhase("failure");
+    if (!m_convergenceEvent.IsRunning())
     {
-      m_bytesTotal += packet->GetSize();
-      m_packetsReceived++;
+      m_convergenceEvent = Simulator::Schedule(Seconds(ConvergenceChecker::kCheckInterval),
+                                               &RoutingExperiment::CheckConvergence, this);
+    }
+  }
+}
 
-      MyTimestampTag tag;
-      if (packet->PeekPacketTag(tag))
+// Injected by the watchdog every progressInterval wall-clock seconds.
+void RoutingExperiment::ReportProgress()
+{
+  auto now = std::chrono::steady_clock::now();
+  double wallElapsed = std::chrono::duration<double>(now - m_wallStart).count();
+  double simNow = Simulator::Now().GetSeconds();
+  double sinceReport = std::chrono::duration<double>(now - m_lastProgressWall).count();
+  uint64_t events = Simulator::GetEventCount();
+  double speed = (simNow - m_lastProgressSim) / sinceReport;
+  double eta = (speed > 0.0) ? (m_totalTime - simNow) / speed : 0.0;
+  double eventRate = (events - m_lastProgressEvents) / sinceReport;
+
+  std::ostringstream line;
+  line << std::fixed << std::setprecision(1)
+       << "[progress] t=" << simNow << "/" << m_totalTime << " s"
+       << " speed=" << std::setprecision(2) << speed << "x"
+       << " eta=" << std::setprecision(0) << eta << " s"
+       << " events/s=" << eventRate
+       << " wall=" << wallElapsed << " s";
+  RUN_LOG(m_log, SUMMARY, line.str());
+  m_log.Flush();
+
+  m_lastProgressWall = now;
+  m_lastProgressSim = simNow;
+  m_lastProgressEvents = events;
+}
+
+// Progress lines and the wall budget are driven from a thread sleeping on
+// the wall clock, so both hold however slowly simulated time moves (a run
+// stuck in retransmissions barely advances it). The thread injects
+// ReportProgress() and WallBudgetExpired() with ScheduleWithContext, which
+// the default simulator accepts from other threads and runs right after
+// the current event, so simulator state is only touched from its thread.
+void RoutingExperiment::StartWatchdog()
+{
+  m_watchdog = std::thread([this] {
+    using Clock = std::chrono::steady_clock;
+    auto deadline = m_wallBudget > 0.0
+                        ? m_wallStart + std::chrono::duration_cast<Clock::duration>(
+                                            std::chrono::duration<double>(m_wallBudget))
+                        : Clock::time_point::max();
+    auto nextProgress = m_progressInterval > 0.0
+                            ? m_wallStart + std::chrono::duration_cast<Clock::duration>(
+                                                std::chrono::duration<double>(m_progressInterval))
+                            : Clock::time_point::max();
+
+    std::unique_lock<std::mutex> lock(m_watchdogMutex);
+    while (!m_watchdogWake.wait_until(lock, std::min(deadline, nextProgress), [this] { return m_runFinished; }))
+    {
+      if (Clock::now() >= deadline)
       {
-        Time delay = Simulator::Now() - tag.GetTimestamp();
-        double delaySeconds = delay.GetSeconds();
-        
-        m_totalDelay += delaySeconds;
-        m_delaySamples++;
-        
-        if (delaySeconds < m_minDelay)
-          m_minDelay = delaySeconds;
-        if (delaySeconds > m_maxDelay)
-          m_maxDelay = delaySeconds;
+        Simulator::ScheduleWithContext(Simulator::NO_CONTEXT, Seconds(0),
+                                       &RoutingExperiment::WallBudgetExpired, this);
+        return;
+      }
+      if (Clock::now() >= nextProgress)
+      {
+        Simulator::ScheduleWithContext(Simulator::NO_CONTEXT, Seconds(0),
+                                       &RoutingExperiment::ReportProgress, this);
+        nextProgress = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                          std::chrono::duration<double>(m_progressInterval));
       }
     }
+  });
+}
+
+void RoutingExperiment::StopWatchdog()
+{
+  if (!m_watchdog.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(m_watchdogMutex);
+    m_runFinished = true;
   }
+  m_watchdogWake.notify_one();
+  m_watchdog.join();
 }
 
-void RoutingExperiment::SendPacket(Ptr<Socket> socket, uint32_t pktSize, uint32_t numPkts, Time interval)
+void RoutingExperiment::WallBudgetExpired()
 {
-  if (numPkts > 0 && Simulator::Now().GetSeconds() < m_totalTime - 1.0)
+  m_truncated = true;
+  RUN_LOG(m_log, SUMMARY, ">>> Wall-clock budget of " << m_wallBudget << " s exhausted at t="
+                              << Simulator::Now().GetSeconds() << " s, stopping");
+  Simulator::Stop();
+}
+
+void RoutingExperiment::SetupPcapCapture(const NetDeviceContainer& devices)
+{
+  std::vector<uint32_t> nodes;
+  if (!ParseNodeList(m_pcapNodes, m_nodes.GetN(), nodes))
   {
-    Ptr<Packet> packet = Create<Packet>(pktSize);
+    NS_FATAL_ERROR("Invalid pcapNodes list: " << m_pcapNodes);
+  }
 
-    MyTimestampTag tag;
-    tag.SetTimestamp(Simulator::Now());
-    packet->AddPacketTag(tag);
+  m_pcap.Configure(m_pcapStart, m_pcapStop, m_pcapTriggerPdr > 0.0);
+  for (uint32_t nodeId : nodes)
+  {
+    m_pcap.Attach(devices.Get(nodeId),
+                  m_outputPrefix + "-PCAP-" + std::to_string(nodeId) + ".pcap",
+                  m_pcapSnapLen);
+  }
+  RUN_LOG(m_log, VERBOSE, "Packet capture enabled on " << m_pcap.GetFileCount() << " nodes");
+}
 
-    int bytesSent = socket->Send(packet);
-    if (bytesSent > 0)
+// Reads the routing table of one node into protocol-neutral entries.
+// OLSR exposes its table directly and DSR is queried per destination;
+// AODV and DSDV only offer their table printers, so those are rendered
+// into memory and parsed. Only valid routes are returned. The AODV, OLSR
+// and DSDV reads are const. DSR has no const accessor: LookupRoute() purges
+// expired entries and may rebuild link-cache routes, so snapshots perturb
+// DSR runs.
+void RoutingExperiment::CollectRoutes(Ptr<Node> node, std::vector<RouteEntry>& entries)
+{
+  entries.clear();
+  int64_t nowMs = Simulator::Now().GetMilliSeconds();
+
+  if (m_protocolName == "OLSR")
+  {
+    Ptr<olsr::RoutingProtocol> olsrProto = node->GetObject<olsr::RoutingProtocol>();
+    for (const olsr::RoutingTableEntry& rt : olsrProto->GetRoutingTableEntries())
     {
-      m_packetsSent++;
+      entries.push_back({rt.destAddr.Get(), rt.nextAddr.Get(), static_cast<uint16_t>(rt.distance), 0, 0});
     }
-    else
+  }
+  else if (m_protocolName == "DSR")
+  {
+    Ptr<DsrRouteCache> cache = node->GetObject<DsrRouting>()->GetRouteCache();
+    for (uint32_t i = 0; i < m_interfaces.GetN(); ++i)
     {
-      m_packetsDropped++;
+      if (i == node->GetId())
+        continue;
+      DsrRouteCacheEntry rt;
+      if (cache->LookupRoute(m_interfaces.GetAddress(i), rt))
+      {
+        std::vector<Ipv4Address> path = rt.GetVector();
+        if (path.size() < 2)
+          continue;
+        entries.push_back({m_interfaces.GetAddress(i).Get(), path[1].Get(),
+                           static_cast<uint16_t>(path.size() - 1), 0,
+                           static_cast<int32_t>(nowMs + rt.GetExpireTime().GetMilliSeconds())});
+      }
     }
+  }
+  else
+  {
+    std::ostringstream table;
+    Ptr<OutputStreamWrapper> stream = Create<OutputStreamWrapper>(&table);
+    bool aodv = (m_protocolName == "AODV");
+    if (aodv)
+      node->GetObject<aodv::RoutingProtocol>()->PrintRoutingTable(stream, Time::S);
+    else
+      node->GetObject<dsdv::RoutingProtocol>()->PrintRoutingTable(stream, Time::S);
 
-    m_socketEvents[socket] = Simulator::Schedule(interval, 
-                                                  &RoutingExperiment::SendPacket, 
-                                                  this, 
-                                                  socket, 
-                                                  pktSize, 
-                                                  numPkts - 1, 
-                                                  interval);
+    Ipv4Mask mask = m_interfaces.Get(0).first->GetAddress(1, 0).GetMask();
+    std::istringstream lines(table.str());
+    std::string line;
+    while (std::getline(lines, line))
+    {
+      std::istringstream fields(line);
+      std::vector<std::string> f;
+      std::string field;
+      while (fields >> field)
+        f.push_back(field);
+
+      // Data rows start with a dotted-quad destination; headers do not.
+      if (f.size() < 6 || std::count(f[0].begin(), f[0].end(), '.') != 3 ||
+          f[0].find_first_not_of("0123456789.") != std::string::npos)
+        continue;
+
+      Ipv4Address destination(f[0].c_str());
+      if (destination.IsLocalhost() || destination.IsBroadcast() ||
+          destination.IsSubnetDirectedBroadcast(mask))
+        continue;
+
+      // AODV: Destination Gateway Interface Flag Expire Hops
+      // DSDV: Destination Gateway Interface HopCount SeqNum LifeTime SettlingTime
+      RouteEntry entry;
+      entry.destination = destination.Get();
+      entry.nextHop = Ipv4Address(f[1].c_str()).Get();
+      if (aodv)
+      {
+        if (f[3] != "UP")
+          continue;
+        entry.hops = static_cast<uint16_t>(std::stoul(f[5]));
+        entry.seqNo = 0;
+        // The printer rounds the remaining lifetime, so the absolute expiry
+        // is kept at 100 ms resolution to avoid spurious deltas.
+        double expiry = nowMs + std::stod(f[4]) * 1000.0;
+        entry.expiryMs = static_cast<int32_t>(std::lround(expiry / 100.0) * 100);
+      }
+      else
+      {
+        entry.hops = static_cast<uint16_t>(std::stoul(f[3]));
+        entry.seqNo = static_cast<uint32_t>(std::stoul(f[4]));
+        entry.expiryMs = 0;
+        if (entry.hops == 0)
+          continue;
+      }
+      entries.push_back(entry);
+    }
   }
 }
 
-void RoutingExperiment::CheckThroughput()
+void RoutingExperiment::TakeRoutingSnapshot()
 {
-  double kbs = (m_bytesTotal * 8.0) / 1000.0;
-  m_bytesTotal = 0;
-
-  double pdr = (m_packetsSent == 0) ? 0.0 : (double)m_packetsReceived / m_packetsSent;
-  double avgDelay = (m_delaySamples == 0) ? 0.0 : m_totalDelay / m_delaySamples;
-
-  std::ofstream out(m_CSVfileName, std::ios::app);
-  out << std::fixed << std::setprecision(4)
-      << Simulator::Now().GetSeconds() << ","
-      << kbs << ","
-      << m_packetsReceived << ","
-      << m_nSinks << ","
-      << m_protocolName << ","
-      << m_txp << ","
-      << pdr << ","
-      << avgDelay << ","
-      << m_routingPackets << std::endl;
-  out.close();
+  double now = Simulator::Now().GetSeconds();
+  std::vector<RouteEntry> entries;
+  for (uint32_t i = 0; i < m_nodes.GetN(); ++i)
+  {
+    CollectRoutes(m_nodes.Get(i), entries);
+    m_rtSnapshots.Write(now, i, entries);
+  }
 
- // m_packetsReceived = 0;
-  
-  if (Simulator::Now().GetSeconds() < m_totalTime - 1.0)
+  if (now + m_rtSnapshotInterval < m_totalTime)
   {
-    Simulator::Schedule(Seconds(1.0), &RoutingExperiment::CheckThroughput, this);
+    Simulator::Schedule(Seconds(m_rtSnapshotInterval), &RoutingExperiment::TakeRoutingSnapshot, this);
   }
 }
 
@@ -240,6 +3050,8 @@ void RoutingExperiment::MacTxCallback(Ptr<const Packet> packet)
   if (packet->GetSize() < 200)
   {
     m_routingPackets++;
+    if (m_rollups)
+      m_rollupEngine.Add(RollupEngine::ROUTING, packet->GetSize());
   }
 }
 
@@ -255,9 +3067,11 @@ void RoutingExperiment::SetupTraffic()
   startTimeRng->SetAttribute("Min", DoubleValue(30.0));
   startTimeRng->SetAttribute("Max", DoubleValue(31.0));
 
-  std::cout << "Setting up " << m_nSinks << " traffic flows..." << std::endl;
-  std::cout << "Packet size: " << packetSize << " bytes" << std::endl;
-  std::cout << "Data rate: " << m_rate << " (" << packetsPerSecond << " pkt/s)" << std::endl;
+  RUN_LOG(m_log, VERBOSE, "Setting up " << m_nSinks << " traffic flows...");
+  RUN_LOG(m_log, VERBOSE, "Packet size: " << packetSize << " bytes");
+  RUN_LOG(m_log, VERBOSE, "Data rate: " << m_rate << " (" << packetsPerSecond << " pkt/s)");
+
+  Callback<void, Ptr<Socket>> receiveCallback = MakeReceiveCallback();
 
   for (int i = 0; i < m_nSinks; i++)
   {
@@ -265,7 +3079,7 @@ void RoutingExperiment::SetupTraffic()
     Ptr<Socket> recvSink = Socket::CreateSocket(m_nodes.Get(i), tid);
     InetSocketAddress local = InetSocketAddress(m_interfaces.GetAddress(i), m_port);
     recvSink->Bind(local);
-    recvSink->SetRecvCallback(MakeCallback(&RoutingExperiment::ReceivePacket, this));
+    recvSink->SetRecvCallback(receiveCallback);
     m_sockets.push_back(recvSink);
 
     Ptr<Socket> source = Socket::CreateSocket(m_nodes.Get(i + m_nSinks), tid);
@@ -277,14 +3091,15 @@ void RoutingExperiment::SetupTraffic()
     uint32_t numPackets = static_cast<uint32_t>((m_totalTime - 30.0) * packetsPerSecond);
     Time startTime = Seconds(startTimeRng->GetValue());
 
-    std::cout << "Flow " << i << ": Node " << (i + m_nSinks) 
-              << " -> Node " << i 
-              << " (" << numPackets << " packets)" << std::endl;
+    RUN_LOG(m_log, VERBOSE, "Flow " << i << ": Node " << (i + m_nSinks)
+                                << " -> Node " << i
+                                << " (" << numPackets << " packets)");
 
     Simulator::Schedule(startTime, 
                        &RoutingExperiment::SendPacket, 
                        this, 
                        source, 
+                       static_cast<uint32_t>(i), 
                        packetSize, 
                        numPackets, 
                        interPacketInterval);
@@ -303,81 +3118,501 @@ void RoutingExperiment::CommandSetup(int argc, char** argv)
   cmd.AddValue("rate", "Data rate (e.g., 2048bps)", m_rate);
   cmd.AddValue("nodeSpeed", "Maximum node speed (m/s)", m_nodeSpeed);
   cmd.AddValue("pauseTime", "Pause time at waypoints (s)", m_pauseTime);
+  cmd.AddValue("delayMetrics", "Track end-to-end delay of received packets", m_delayMetrics);
+  cmd.AddValue("liveSocket", "UNIX datagram socket path to stream interval rows to", m_liveSocket);
+  cmd.AddValue("progressInterval", "Wall-clock seconds between progress lines (0 = off)", m_progressInterval);
+  cmd.AddValue("wallBudget", "Wall-clock budget in seconds; the run is truncated after it (0 = none)", m_wallBudget);
+  cmd.AddValue("codeVersion", "Code version recorded in the run summary", m_codeVersion);
+  cmd.AddValue("verbosity", "Console/log verbosity (silent, summary, verbose)", m_verbosity);
+  cmd.AddValue("logFile", "Write run messages to this file instead of stdout", m_logFile);
+  cmd.AddValue("compress", "Gzip the CSV, log and animation outputs", m_compress);
+  cmd.AddValue("pcapNodes", "Nodes to capture, e.g. \"all\" or \"0,3,5-8\" (empty = off)", m_pcapNodes);
+  cmd.AddValue("pcapStart", "Start of the capture window (s)", m_pcapStart);
+  cmd.AddValue("pcapStop", "End of the capture window (s, 0 = end of run)", m_pcapStop);
+  cmd.AddValue("pcapSnapLen", "Bytes captured per packet", m_pcapSnapLen);
+  cmd.AddValue("pcapTriggerPdr", "Only capture after an interval PDR below this value (0 = always)", m_pcapTriggerPdr);
+  cmd.AddValue("pcapTriggerHold", "Seconds to keep capturing after the trigger fires", m_pcapTriggerHold);
+  cmd.AddValue("rtSnapshotInterval", "Seconds between binary routing-table snapshots (0 = off)", m_rtSnapshotInterval);
+  cmd.AddValue("rollups", "Write 100 ms/1 s/10 s/60 s metric rollups, one file per resolution", m_rollups);
+  cmd.AddValue("floodMetrics", "Track AODV/DSR route-request floods (rebroadcasts, duplicates, reach)", m_floodMetrics);
+  cmd.AddValue("loopDetection", "Detect data packets that return to a node that already forwarded them (routing loops)", m_loopDetection);
+  cmd.AddValue("queueMonitor", "Sample MAC queue and routing buffer occupancy into per-interval columns", m_queueMonitor);
+  cmd.AddValue("convergence", "Measure OLSR/DSDV route convergence after startup and node failure", m_convergence);
+  cmd.AddValue("failNode", "Node whose interface goes down at failAt (-1 = none)", m_failNode);
+  cmd.AddValue("failAt", "Time of the node failure (s)", m_failAt);
+  cmd.AddValue("fidelity", "Link layer: full (802.11b) or screen (abstract, for sweep screening)", m_fidelity);
+  cmd.AddValue("screenRange", "Screening delivery range (m, 0 = where the default loss model reaches -94 dBm)", m_screenRange);
+  cmd.AddValue("screenAirtime", "Screening airtime per frame (s)", m_screenAirtime);
+  cmd.AddValue("obstacles", "Building map file, one \"xMin yMin xMax yMax [wallLossDb]\" per line (empty = none)", m_obstacles);
+  cmd.AddValue("wallLoss", "Loss per building wall crossed (dB) when the map gives none", m_wallLoss);
+  cmd.AddValue("fading", "Small-scale fading (none, rayleigh, nakagami)", m_fading);
+  cmd.AddValue("nakagamiM", "Nakagami shape parameter m (1-8)", m_nakagamiM);
+  cmd.AddValue("fadingCoherence", "Fading coherence time (s)", m_fadingCoherence);
+  cmd.AddValue("lossKernel", "Log-distance loss: scalar, batch (vectorised per transmission) or validate", m_lossKernel);
+  cmd.AddValue("lossThreads", "Threads computing each batch loss row (1 = simulator thread only)", m_lossThreads);
   cmd.Parse(argc, argv);
 
+  Verbosity level;
+  if (!RunLogger::ParseVerbosity(m_verbosity, level))
+  {
+    std::cerr << "Error: verbosity must be silent, summary or verbose" << std::endl;
+    std::exit(1);
+  }
+  if (!m_log.Open(level, m_logFile, m_compress))
+  {
+    std::cerr << "Error: cannot open log file " << m_logFile << std::endl;
+    std::exit(1);
+  }
+
   if (m_nSinks * 2 > m_nWifis)
   {
     std::cerr << "Error: nSinks * 2 must be <= nWifis" << std::endl;
     std::exit(1);
   }
+
+  if (m_failNode >= m_nWifis)
+  {
+    std::cerr << "Error: failNode must be < nWifis" << std::endl;
+    std::exit(1);
+  }
+
+  if (m_fidelity != "full" && m_fidelity != "screen")
+  {
+    std::cerr << "Error: fidelity must be full or screen" << std::endl;
+    std::exit(1);
+  }
+
+  if (m_fading != "none" && m_fading != "rayleigh" && m_fading != "nakagami")
+  {
+    std::cerr << "Error: fading must be none, rayleigh or nakagami" << std::endl;
+    std::exit(1);
+  }
+
+  if (m_fadingCoherence <= 0.0)
+  {
+    std::cerr << "Error: fadingCoherence must be > 0" << std::endl;
+    std::exit(1);
+  }
+
+  if (m_lossKernel != "scalar" && m_lossKernel != "batch" && m_lossKernel != "validate")
+  {
+    std::cerr << "Error: lossKernel must be scalar, batch or validate" << std::endl;
+    std::exit(1);
+  }
+
+  if (m_lossThreads == 0 || (m_lossThreads > 1 && m_lossKernel == "scalar"))
+  {
+    std::cerr << "Error: lossThreads must be >= 1, and > 1 needs lossKernel=batch or validate" << std::endl;
+    std::exit(1);
+  }
+
+  // DSR sits on the WiFi MAC (promiscuous mode, transmit-error feedback).
+  if (m_fidelity == "screen" && m_protocolName == "DSR")
+  {
+    std::cerr << "Error: DSR needs the WiFi stack; use fidelity=full" << std::endl;
+    std::exit(1);
+  }
 }
 
 void RoutingExperiment::PrintFinalStatistics()
 {
-  std::cout << "\n========================================" << std::endl;
-  std::cout << "FINAL STATISTICS - " << m_protocolName << std::endl;
-  std::cout << "========================================" << std::endl;
-  std::cout << "Total packets sent: " << m_packetsSent << std::endl;
-  std::cout << "Total packets received: " << m_packetsReceived << std::endl;
-  std::cout << "Packets dropped: " << m_packetsDropped << std::endl;
+  RUN_LOG(m_log, SUMMARY, "\n========================================");
+  RUN_LOG(m_log, SUMMARY, "FINAL STATISTICS - " << m_protocolName);
+  RUN_LOG(m_log, SUMMARY, "========================================");
+  if (m_truncated)
+  {
+    RUN_LOG(m_log, SUMMARY, "*** TRUNCATED at " << Simulator::Now().GetSeconds() << " of "
+                                << m_totalTime << " seconds (wall-clock budget) ***");
+  }
+  RUN_LOG(m_log, SUMMARY, "Total packets sent: " << m_packetsSent);
+  RUN_LOG(m_log, SUMMARY, "Total packets received: " << m_packetsReceived);
+  RUN_LOG(m_log, SUMMARY, "Packets dropped: " << m_packetsDropped);
   
   double finalPDR = (m_packetsSent == 0) ? 0.0 : (double)m_packetsReceived / m_packetsSent;
-  std::cout << "Overall PDR: " << std::fixed << std::setprecision(4) 
-            << (finalPDR * 100.0) << "%" << std::endl;
+  RUN_LOG(m_log, SUMMARY, "Overall PDR: " << std::fixed << std::setprecision(4)
+                              << (finalPDR * 100.0) << "%");
   
-  double avgDelay = (m_delaySamples == 0) ? 0.0 : m_totalDelay / m_delaySamples;
-  std::cout << "Average delay: " << avgDelay << " seconds" << std::endl;
-  std::cout << "Min delay: " << m_minDelay << " seconds" << std::endl;
-  std::cout << "Max delay: " << m_maxDelay << " seconds" << std::endl;
-  std::cout << "Total routing packets: " << m_routingPackets << std::endl;
-  std::cout << "========================================\n" << std::endl;
+  if (m_delayMetrics)
+  {
+    const DelayStats& delay = m_metrics.delay;
+    RUN_LOG(m_log, SUMMARY, "Average delay: " << delay.Mean() << " seconds");
+    RUN_LOG(m_log, SUMMARY, "Min delay: " << ((delay.samples == 0) ? 0.0 : delay.min) << " seconds");
+    RUN_LOG(m_log, SUMMARY, "Max delay: " << delay.max << " seconds");
+  }
+  else
+  {
+    RUN_LOG(m_log, SUMMARY, "Delay metrics: disabled");
+  }
+  RUN_LOG(m_log, SUMMARY, "Total routing packets: " << m_routingPackets);
+  if (m_screenChannel)
+  {
+    RUN_LOG(m_log, SUMMARY, "Screening frames dropped waiting for the medium: "
+                                << m_screenChannel->GetDeferDrops());
+  }
+  if (m_obstacleModel)
+  {
+    uint64_t lookups = m_obstacleModel->GetLookups();
+    RUN_LOG(m_log, SUMMARY, "Line-of-sight checks: " << lookups << " (computed: " << m_obstacleModel->GetMisses()
+                                << ", cache hits: "
+                                << ((lookups == 0) ? 0.0 : 100.0 * (lookups - m_obstacleModel->GetMisses()) / lookups)
+                                << "%)");
+  }
+  if (m_fadingModel)
+  {
+    RUN_LOG(m_log, SUMMARY, "Fading links: peak " << m_fadingModel->GetPeakLinks() << " of "
+                                << m_nWifis * (m_nWifis - 1) / 2 << " pairs (created: "
+                                << m_fadingModel->GetCreated() << ", evicted: " << m_fadingModel->GetEvicted() << ")");
+  }
+  if (m_batchLoss)
+  {
+    uint64_t rows = m_batchLoss->GetRows();
+    RUN_LOG(m_log, SUMMARY, "Batch loss kernel: " << rows << " rows for " << m_batchLoss->GetQueries()
+                                << " queries (" << ((rows == 0) ? 0.0 : (double)m_batchLoss->GetQueries() / rows)
+                                << " per row, " << m_batchLoss->GetParallelRows() << " split over "
+                                << m_batchLoss->GetThreads() << " threads)");
+    if (m_lossKernel == "validate")
+      RUN_LOG(m_log, SUMMARY, "Batch loss kernel max error vs scalar: " << m_batchLoss->GetMaxError() << " dB");
+  }
+  for (const ConvergenceChecker::Phase& phase : m_convergenceChecker.GetPhases())
+  {
+    if (phase.converged >= 0.0)
+      RUN_LOG(m_log, SUMMARY, "Convergence after " << phase.name << ": " << phase.converged << " seconds");
+    else
+      RUN_LOG(m_log, SUMMARY, "Convergence after " << phase.name << ": not reached");
+  }
+  if (m_loops.IsEnabled())
+  {
+    RUN_LOG(m_log, SUMMARY, "Looped packets: " << m_loops.GetLoopedPackets()
+                                << " (extra transmissions: " << m_loops.GetExtraTransmissions() << ")");
+  }
+  if (m_floods.IsEnabled())
+  {
+    RUN_LOG(m_log, SUMMARY, "Route request floods: " << m_floods.GetFloods());
+    RUN_LOG(m_log, SUMMARY, "Rebroadcasts: " << m_floods.GetRebroadcasts()
+                                << " (redundant: " << m_floods.GetRedundantRatio() * 100.0 << "%)");
+    RUN_LOG(m_log, SUMMARY, "Duplicate receptions: " << m_floods.GetDuplicates()
+                                << " (" << m_floods.GetDuplicateRatio() * 100.0 << "% of receptions)");
+    RUN_LOG(m_log, SUMMARY, "Mean flood reach: " << m_floods.GetMeanReach() << " nodes in "
+                                << m_floods.GetMeanCompletion() << " seconds");
+  }
+  RUN_LOG(m_log, SUMMARY, "========================================\n");
+}
+
+// Everything needed to reproduce and aggregate a run, written as
+// <prefix>-SUMMARY.json next to the CSV once every output is closed, so
+// outputs only lists files that exist.
+void RoutingExperiment::WriteRunSummary(const std::string& animFileName)
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+#if defined(ENABLE_BUILD_VERSION) && __has_include("ns3/version.h")
+  std::string ns3Version = Version::LongVersion();
+#else
+  std::string ns3Version = "unknown";
+#endif
+
+  JsonObject parameters;
+  parameters.AddString("protocol", m_protocolName)
+      .AddInt("nWifis", m_nWifis)
+      .AddInt("nSinks", m_nSinks)
+      .AddNumber("totalTime", m_totalTime)
+      .AddNumber("txp", m_txp)
+      .AddString("rate", m_rate)
+      .AddNumber("nodeSpeed", m_nodeSpeed)
+      .AddNumber("pauseTime", m_pauseTime)
+      .AddBool("delayMetrics", m_delayMetrics)
+      .AddString("liveSocket", m_liveSocket)
+      .AddNumber("progressInterval", m_progressInterval)
+      .AddNumber("wallBudget", m_wallBudget)
+      .AddString("verbosity", m_verbosity)
+      .AddString("logFile", m_logFile)
+      .AddBool("compress", m_compress)
+      .AddString("pcapNodes", m_pcapNodes)
+      .AddNumber("pcapStart", m_pcapStart)
+      .AddNumber("pcapStop", m_pcapStop)
+      .AddInt("pcapSnapLen", m_pcapSnapLen)
+      .AddNumber("pcapTriggerPdr", m_pcapTriggerPdr)
+      .AddNumber("pcapTriggerHold", m_pcapTriggerHold)
+      .AddNumber("rtSnapshotInterval", m_rtSnapshotInterval)
+      .AddBool("rollups", m_rollups)
+      .AddBool("floodMetrics", m_floodMetrics)
+      .AddBool("loopDetection", m_loopDetection)
+      .AddBool("queueMonitor", m_queueMonitor)
+      .AddBool("convergence", m_convergence)
+      .AddInt("failNode", m_failNode)
+      .AddNumber("failAt", m_failAt)
+      .AddString("fidelity", m_fidelity)
+      .AddNumber("screenRange", m_screenRange)
+      .AddNumber("screenAirtime", m_screenAirtime)
+      .AddString("obstacles", m_obstacles)
+      .AddNumber("wallLoss", m_wallLoss)
+      .AddString("fading", m_fading)
+      .AddInt("nakagamiM", m_nakagamiM)
+      .AddNumber("fadingCoherence", m_fadingCoherence)
+      .AddString("lossKernel", m_lossKernel)
+      .AddInt("lossThreads", m_lossThreads);
+
+  JsonObject run;
+  run.AddInt("seed", RngSeedManager::GetSeed())
+      .AddInt("run", RngSeedManager::GetRun())
+      .AddString("ns3Version", ns3Version)
+      .AddString("codeVersion", m_codeVersion)
+      .AddNumber("wallTimeSeconds", m_runWallSeconds)
+      .AddInt("peakRssKb", usage.ru_maxrss)
+      .AddInt("eventCount", m_eventCount)
+      .AddNumber("simulatedSeconds", m_simulatedSeconds)
+      .AddBool("truncated", m_truncated);
+
+  const DelayStats& delay = m_metrics.delay;
+  JsonObject metrics;
+  metrics.AddInt("packetsSent", m_packetsSent)
+      .AddInt("packetsReceived", m_packetsReceived)
+      .AddInt("packetsDropped", m_packetsDropped)
+      .AddNumber("pdr", (m_packetsSent == 0) ? 0.0 : (double)m_packetsReceived / m_packetsSent)
+      .AddInt("routingPackets", m_routingPackets);
+  if (m_screenChannel)
+    metrics.AddInt("screenDeferDrops", m_screenChannel->GetDeferDrops());
+  if (m_obstacleModel)
+  {
+    JsonObject obstacles;
+    obstacles.AddInt("buildings", m_obstacleModel->GetBuildingCount())
+        .AddInt("losLookups", m_obstacleModel->GetLookups())
+        .AddInt("losComputed", m_obstacleModel->GetMisses());
+    metrics.AddObject("obstacles", obstacles);
+  }
+  if (m_fadingModel)
+  {
+    JsonObject fading;
+    fading.AddInt("linksCreated", m_fadingModel->GetCreated())
+        .AddInt("linksEvicted", m_fadingModel->GetEvicted())
+        .AddInt("peakLinks", m_fadingModel->GetPeakLinks());
+    metrics.AddObject("fading", fading);
+  }
+  if (m_batchLoss)
+  {
+    JsonObject kernel;
+    kernel.AddInt("queries", m_batchLoss->GetQueries())
+        .AddInt("rows", m_batchLoss->GetRows())
+        .AddInt("parallelRows", m_batchLoss->GetParallelRows());
+    if (m_lossKernel == "validate")
+      kernel.AddNumber("maxErrorDb", m_batchLoss->GetMaxError());
+    metrics.AddObject("lossKernel", kernel);
+  }
+  if (m_delayMetrics)
+  {
+    metrics.AddNumber("avgDelay", delay.Mean())
+        .AddNumber("minDelay", (delay.samples == 0) ? 0.0 : delay.min)
+        .AddNumber("maxDelay", delay.max);
+  }
+  if (!m_convergenceChecker.GetPhases().empty())
+  {
+    // Seconds from the phase start; null when the phase never converged.
+    JsonObject convergence;
+    for (const ConvergenceChecker::Phase& phase : m_convergenceChecker.GetPhases())
+    {
+      convergence.AddNumber(phase.name + "Seconds", (phase.converged >= 0.0)
+                                                        ? phase.converged
+                                                        : std::numeric_limits<double>::quiet_NaN());
+    }
+    metrics.AddObject("convergence", convergence);
+  }
+  if (m_loops.IsEnabled())
+  {
+    metrics.AddInt("loopedPackets", m_loops.GetLoopedPackets())
+        .AddInt("loopExtraTransmissions", m_loops.GetExtraTransmissions());
+  }
+  if (m_floods.IsEnabled())
+  {
+    JsonObject flooding;
+    flooding.AddInt("floods", m_floods.GetFloods())
+        .AddInt("rebroadcasts", m_floods.GetRebroadcasts())
+        .AddNumber("redundantRebroadcastRatio", m_floods.GetRedundantRatio())
+        .AddInt("duplicateReceptions", m_floods.GetDuplicates())
+        .AddNumber("duplicateReceptionRatio", m_floods.GetDuplicateRatio())
+        .AddNumber("meanReach", m_floods.GetMeanReach())
+        .AddNumber("meanCompletionSeconds", m_floods.GetMeanCompletion());
+    metrics.AddObject("flooding", flooding);
+  }
+
+  JsonObject outputs;
+  auto addOutput = [](JsonObject& object, const std::string& key, const std::string& path) {
+    if (!path.empty() && access(path.c_str(), F_OK) == 0)
+      object.AddString(key, path);
+  };
+  addOutput(outputs, "csv", m_writer.GetPath());
+  addOutput(outputs, "routingSnapshots", m_rtSnapshots.GetPath());
+  if (m_rollups)
+  {
+    JsonObject rollups;
+    for (size_t level = 0; level < RollupEngine::kLevels; ++level)
+      addOutput(rollups, m_rollupEngine.GetLevelName(level), m_rollupEngine.GetPath(level));
+    outputs.AddObject("rollups", rollups);
+  }
+  if (m_floods.IsEnabled())
+    addOutput(outputs, "floods", m_floods.GetPath());
+  if (!m_convergenceChecker.GetPhases().empty())
+    addOutput(outputs, "convergence", m_convergenceChecker.GetPath());
+  addOutput(outputs, "animation", animFileName);
+
+  JsonObject summary;
+  summary.AddObject("parameters", parameters)
+      .AddObject("run", run)
+      .AddObject("metrics", metrics)
+      .AddObject("outputs", outputs);
+
+  std::ofstream out(m_outputPrefix + "-SUMMARY.json");
+  out << summary.Str() << "\n";
 }
 
 void RoutingExperiment::Run()
 {
-  m_CSVfileName = m_protocolName + "-OUTPUT.csv";
+  // Screening outputs get their own names so that a full run of the same
+  // protocol never overwrites them and the analysis scripts can skip them.
+  m_outputPrefix = m_fidelity == "screen" ? m_protocolName + "-SCREEN" : m_protocolName;
+  m_CSVfileName = m_outputPrefix + "-OUTPUT.csv";
 
-  std::ofstream out(m_CSVfileName);
-  out << "Time,ThroughputKbps,PacketsReceived,Sinks,Protocol,TxPower,PDR,AvgDelay,RoutingOverhead\n";
-  out.close();
+  if (!m_liveSocket.empty() && !m_writer.EnableLiveStream(m_liveSocket))
+  {
+    std::cerr << "Warning: cannot stream to " << m_liveSocket << std::endl;
+  }
+  // The detectors hook the WiFi MAC, so the screening link layer has none;
+  // register their columns only when they will actually be filled.
+  bool wifiStack = m_fidelity == "full";
+  if (m_loopDetection && wifiStack)
+  {
+    m_loopColumn = m_writer.AddColumn("LoopedPackets");
+    m_writer.AddColumn("LoopExtraTx");
+  }
+  if (m_queueMonitor && wifiStack)
+  {
+    m_queueColumn = m_writer.AddColumn("MacQueueMean");
+    m_writer.AddColumn("MacQueueMax");
+    m_writer.AddColumn("RouteBufferMean");
+    m_writer.AddColumn("RouteBufferMax");
+    m_writer.AddColumn("IntervalDelay");
+  }
+  if (!m_writer.Open(m_CSVfileName, m_compress, m_nSinks, m_protocolName, m_txp))
+  {
+    NS_FATAL_ERROR("Cannot open output file " << m_CSVfileName);
+  }
 
-  std::cout << "\n========================================" << std::endl;
-  std::cout << "MANET Routing Protocol Comparison" << std::endl;
-  std::cout << "========================================" << std::endl;
-  std::cout << "Protocol: " << m_protocolName << std::endl;
-  std::cout << "Number of nodes: " << m_nWifis << std::endl;
-  std::cout << "Number of flows: " << m_nSinks << std::endl;
-  std::cout << "Simulation time: " << m_totalTime << " seconds" << std::endl;
-  std::cout << "Node speed: 1-" << m_nodeSpeed << " m/s" << std::endl;
-  std::cout << "Tx power: " << m_txp << " dBm" << std::endl;
-  std::cout << "========================================\n" << std::endl;
+  RUN_LOG(m_log, SUMMARY, "\n========================================");
+  RUN_LOG(m_log, SUMMARY, "MANET Routing Protocol Comparison");
+  RUN_LOG(m_log, SUMMARY, "========================================");
+  RUN_LOG(m_log, SUMMARY, "Protocol: " << m_protocolName);
+  RUN_LOG(m_log, SUMMARY, "Number of nodes: " << m_nWifis);
+  RUN_LOG(m_log, SUMMARY, "Number of flows: " << m_nSinks);
+  RUN_LOG(m_log, SUMMARY, "Simulation time: " << m_totalTime << " seconds");
+  RUN_LOG(m_log, SUMMARY, "Node speed: 1-" << m_nodeSpeed << " m/s");
+  RUN_LOG(m_log, SUMMARY, "Tx power: " << m_txp << " dBm");
+  if (m_fidelity == "screen")
+    RUN_LOG(m_log, SUMMARY, "Fidelity: screening (abstract link layer)");
+  RUN_LOG(m_log, SUMMARY, "========================================\n");
 
   m_nodes.Create(m_nWifis);
-  std::cout << "Created " << m_nWifis << " nodes" << std::endl;
+  RUN_LOG(m_log, VERBOSE, "Created " << m_nWifis << " nodes");
+
+  NetDeviceContainer devices;
+  // Loss model giving the true topology for the convergence checks.
+  Ptr<PropagationLossModel> linkLoss;
+  if (m_fidelity == "screen")
+  {
+    // Same log-distance defaults as YansWifiChannelHelper::Default().
+    Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel>();
+    if (m_screenRange <= 0.0)
+      m_screenRange = ScreeningChannel::RangeFor(loss, m_txp, ConvergenceChecker::kLinkThresholdDbm);
+    linkLoss = loss;
+
+    m_screenChannel = CreateObject<ScreeningChannel>();
+    m_screenChannel->Configure(m_screenRange, Seconds(m_screenAirtime));
+    m_screenChannel->SetTxCallback(MakeCallback(&RoutingExperiment::MacTxCallback, this));
+    SimpleNetDeviceHelper simple;
+    devices = simple.Install(m_nodes, m_screenChannel);
+    RUN_LOG(m_log, SUMMARY, "Screening link layer: range " << m_screenRange << " m, airtime "
+                                << m_screenAirtime * 1000.0 << " ms");
+
+    if (!m_pcapNodes.empty() || m_loopDetection || m_queueMonitor || !m_obstacles.empty() ||
+        m_fading != "none" || m_lossKernel != "scalar")
+    {
+      RUN_LOG(m_log, SUMMARY, "Ignoring WiFi-stack options in screening mode (pcapNodes, loopDetection, "
+                              "queueMonitor, obstacles, fading, lossKernel)");
+    }
+  }
+  else
+  {
+    // WiFi configuration - FIXED
+    WifiHelper wifi;
+    wifi.SetStandard(WIFI_STANDARD_80211b);
+    wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
+                                 "DataMode", StringValue("DsssRate11Mbps"),
+                                 "ControlMode", StringValue("DsssRate1Mbps"));
+
+    YansWifiPhyHelper wifiPhy;
+    YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default();
+    Ptr<YansWifiChannel> channel = wifiChannel.Create();
+    wifiPhy.SetChannel(channel);
+
+    // FIXED: Use the parameter value for tx power
+    wifiPhy.Set("TxPowerStart", DoubleValue(m_txp));
+    wifiPhy.Set("TxPowerEnd", DoubleValue(m_txp));
+
+    WifiMacHelper wifiMac;
+    wifiMac.SetType("ns3::AdhocWifiMac");
 
-  // WiFi configuration - FIXED
-  WifiHelper wifi;
-  wifi.SetStandard(WIFI_STANDARD_80211b);
-  wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
-                               "DataMode", StringValue("DsssRate11Mbps"),
-                               "ControlMode", StringValue("DsssRate1Mbps"));
+    devices = wifi.Install(wifiPhy, wifiMac, m_nodes);
+    RUN_LOG(m_log, VERBOSE, "WiFi devices installed");
 
-  YansWifiPhyHelper wifiPhy;
-  YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default();
-  wifiPhy.SetChannel(wifiChannel.Create());
+    PointerValue loss;
+    channel->GetAttribute("PropagationLossModel", loss);
+    linkLoss = loss.Get<PropagationLossModel>();
 
-  // FIXED: Use the parameter value for tx power
-  wifiPhy.Set("TxPowerStart", DoubleValue(m_txp));
-  wifiPhy.Set("TxPowerEnd", DoubleValue(m_txp));
+    if (m_lossKernel != "scalar")
+    {
+      m_batchLoss = CreateObject<BatchLossModel>();
+      m_batchLoss->Configure(DynamicCast<LogDistancePropagationLossModel>(linkLoss), m_lossKernel == "validate");
+      m_batchLoss->SetThreads(m_lossThreads);
+      channel->SetPropagationLossModel(m_batchLoss);
+      linkLoss = m_batchLoss;
+    }
+
+    if (!m_obstacles.empty())
+    {
+      m_obstacleModel = CreateObject<ObstacleLossModel>();
+      if (!m_obstacleModel->Load(m_obstacles, m_wallLoss))
+      {
+        NS_FATAL_ERROR("Cannot read obstacle map " << m_obstacles);
+      }
+      linkLoss->SetNext(m_obstacleModel);
+      RUN_LOG(m_log, SUMMARY, "Obstacles: " << m_obstacleModel->GetBuildingCount() << " buildings from "
+                                  << m_obstacles);
+    }
+
+    // The channel gets the faded model; linkLoss stays the mean one, so
+    // the convergence checks judge routes against the average topology.
+    if (m_fading != "none")
+    {
+      uint32_t m = (m_fading == "rayleigh") ? 1 : m_nakagamiM;
+      m_fadingModel = CreateObject<FadingLossModel>();
+      m_fadingModel->Configure(linkLoss, m, m_fadingCoherence);
+      channel->SetPropagationLossModel(m_fadingModel);
+      RUN_LOG(m_log, SUMMARY, "Fading: Nakagami m=" << m << ", coherence " << m_fadingCoherence << " s");
+    }
 
-  WifiMacHelper wifiMac;
-  wifiMac.SetType("ns3::AdhocWifiMac");
+    Config::ConnectWithoutContext("/NodeList/*/DeviceList/*/Mac/MacTx",
+                                  MakeCallback(&RoutingExperiment::MacTxCallback, this));
 
-  NetDeviceContainer devices = wifi.Install(wifiPhy, wifiMac, m_nodes);
-  std::cout << "WiFi devices installed" << std::endl;
+    if (!m_pcapNodes.empty())
+    {
+      SetupPcapCapture(devices);
+    }
 
-  Config::ConnectWithoutContext("/NodeList/*/DeviceList/*/Mac/MacTx",
-                                MakeCallback(&RoutingExperiment::MacTxCallback, this));
+    if (m_queueMonitor)
+    {
+      m_queues.Setup(devices, m_nSinks);
+      Simulator::Schedule(Seconds(QueueMonitor::kSamplePeriod), &RoutingExperiment::SampleQueues, this);
+    }
+  }
 
   // Mobility model - FIXED: Smaller area (200x200 instead of 300x300)
   MobilityHelper mobility;
@@ -400,26 +3635,32 @@ void RoutingExperiment::Run()
                             "PositionAllocator", PointerValue(positionAlloc));
   mobility.SetPositionAllocator(positionAlloc);
   mobility.Install(m_nodes);
-  std::cout << "Mobility model configured" << std::endl;
+  RUN_LOG(m_log, VERBOSE, "Mobility model configured");
+
+  if (m_batchLoss)
+  {
+    m_batchLoss->Attach(m_nodes);
+  }
 
-  AnimationInterface anim(m_protocolName + "-ANIM.xml");
+  std::string animFileName = m_outputPrefix + "-ANIM.xml";
+  auto anim = std::make_unique<AnimationInterface>(animFileName);
   for (uint32_t i = 0; i < m_nodes.GetN(); ++i)
   {
-    anim.UpdateNodeDescription(i, "N" + std::to_string(i));
+    anim->UpdateNodeDescription(i, "N" + std::to_string(i));
     
     if (i < (uint32_t)m_nSinks)
-      anim.UpdateNodeColor(i, 0, 0, 255);
+      anim->UpdateNodeColor(i, 0, 0, 255);
     else if (i < (uint32_t)(m_nSinks * 2))
-      anim.UpdateNodeColor(i, 255, 0, 0);
+      anim->UpdateNodeColor(i, 255, 0, 0);
     else
-      anim.UpdateNodeColor(i, 0, 255, 0);
+      anim->UpdateNodeColor(i, 0, 255, 0);
   }
 
   InternetStackHelper internet;
 
   if (m_protocolName == "DSR")
   {
-    std::cout << "Installing DSR routing..." << std::endl;
+    RUN_LOG(m_log, VERBOSE, "Installing DSR routing...");
     internet.Install(m_nodes);
     DsrMainHelper dsrMain;
     DsrHelper dsr;
@@ -431,19 +3672,19 @@ void RoutingExperiment::Run()
 
     if (m_protocolName == "AODV")
     {
-      std::cout << "Installing AODV routing..." << std::endl;
+      RUN_LOG(m_log, VERBOSE, "Installing AODV routing...");
       AodvHelper aodv;
       list.Add(aodv, 100);
     }
     else if (m_protocolName == "OLSR")
     {
-      std::cout << "Installing OLSR routing..." << std::endl;
+      RUN_LOG(m_log, VERBOSE, "Installing OLSR routing...");
       OlsrHelper olsr;
       list.Add(olsr, 100);
     }
     else if (m_protocolName == "DSDV")
     {
-      std::cout << "Installing DSDV routing..." << std::endl;
+      RUN_LOG(m_log, VERBOSE, "Installing DSDV routing...");
       DsdvHelper dsdv;
       list.Add(dsdv, 100);
     }
@@ -459,22 +3700,127 @@ void RoutingExperiment::Run()
   Ipv4AddressHelper address;
   address.SetBase("10.1.1.0", "255.255.255.0");
   m_interfaces = address.Assign(devices);
-  std::cout << "IP addresses assigned" << std::endl;
+  RUN_LOG(m_log, VERBOSE, "IP addresses assigned");
+
+  if (m_loopDetection && m_fidelity == "full")
+  {
+    for (uint32_t i = 0; i < devices.GetN(); ++i)
+      m_loops.Attach(devices.Get(i), i);
+  }
 
   SetupTraffic();
 
   Simulator::Schedule(Seconds(1.0), &RoutingExperiment::CheckThroughput, this);
 
-  std::cout << "\n>>> Starting simulation..." << std::endl;
+  if (m_convergence)
+  {
+    if (m_protocolName != "OLSR" && m_protocolName != "DSDV")
+    {
+      RUN_LOG(m_log, SUMMARY, "Convergence is only measured for OLSR and DSDV; ignoring convergence");
+    }
+    else
+    {
+      if (!m_convergenceChecker.Open(m_outputPrefix + "-CONVERGENCE.csv", m_compress, m_nodes,
+                                     m_interfaces, linkLoss, m_txp))
+      {
+        NS_FATAL_ERROR("Cannot open convergence file");
+      }
+      m_convergenceChecker.BeginPhase("startup");
+      m_convergenceEvent = Simulator::Schedule(Seconds(ConvergenceChecker::kCheckInterval),
+                                               &RoutingExperiment::CheckConvergence, this);
+    }
+  }
+
+  if (m_failNode >= 0)
+  {
+    Simulator::Schedule(Seconds(m_failAt), &RoutingExperiment::FailNode, this);
+  }
+
+  if (m_floodMetrics)
+  {
+    if (m_protocolName != "AODV" && m_protocolName != "DSR")
+    {
+      RUN_LOG(m_log, SUMMARY, "Flood metrics only apply to AODV and DSR; ignoring floodMetrics");
+    }
+    else
+    {
+      if (!m_floods.Open(m_outputPrefix + "-FLOODS.csv", m_compress, m_interfaces))
+      {
+        NS_FATAL_ERROR("Cannot open flood metrics file");
+      }
+      for (uint32_t i = 0; i < m_nodes.GetN(); ++i)
+        m_floods.Attach(m_nodes.Get(i));
+    }
+  }
+
+  if (m_rtSnapshotInterval > 0.0)
+  {
+    if (!m_rtSnapshots.Open(m_outputPrefix + "-RTSNAP.bin", m_compress, m_nodes.GetN()))
+    {
+      NS_FATAL_ERROR("Cannot open routing snapshot file");
+    }
+    if (m_protocolName == "DSR")
+    {
+      RUN_LOG(m_log, SUMMARY, "Warning: DSR route-cache snapshots purge and rebuild the cache; "
+                              "keep rtSnapshotInterval=0 for comparative runs");
+    }
+    Simulator::Schedule(Seconds(m_rtSnapshotInterval), &RoutingExperiment::TakeRoutingSnapshot, this);
+  }
+
+  if (m_rollups)
+  {
+    if (!m_rollupEngine.Open(m_outputPrefix + "-ROLLUP", m_compress))
+    {
+      NS_FATAL_ERROR("Cannot open rollup files");
+    }
+    m_metrics.rollups = &m_rollupEngine;
+    Simulator::Schedule(MilliSeconds(100), &RoutingExperiment::RollupTick, this);
+  }
+
+  RUN_LOG(m_log, VERBOSE, "\n>>> Starting simulation...");
+  m_wallStart = std::chrono::steady_clock::now();
+  m_lastProgressWall = m_wallStart;
+  if (m_progressInterval > 0.0 || m_wallBudget > 0.0)
+  {
+    StartWatchdog();
+  }
+
   Simulator::Stop(Seconds(m_totalTime));
   Simulator::Run();
+  StopWatchdog();
+  m_runWallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_wallStart).count();
+  m_simulatedSeconds = Simulator::Now().GetSeconds();
+  m_eventCount = Simulator::GetEventCount();
+  m_rollupEngine.Close(m_simulatedSeconds);
+  m_floods.Close();
+  m_convergenceChecker.Close();
   
   PrintFinalStatistics();
   
   Simulator::Destroy();
+  m_writer.Close();
+  m_rtSnapshots.Close();
+
+  // AnimationInterface owns its file, so it can only be compressed once
+  // the interface has written its closing tags.
+  anim.reset();
+  if (m_compress)
+  {
+    std::string command = "gzip -f " + OutputFile::ShellQuote(animFileName);
+    if (std::system(command.c_str()) == 0)
+      animFileName += ".gz";
+  }
+  WriteRunSummary(animFileName);
 
-  std::cout << "Results saved to: " << m_CSVfileName << std::endl;
-  std::cout << "Animation saved to: " << m_protocolName << "-ANIM.xml" << std::endl;
+  RUN_LOG(m_log, SUMMARY, "Results saved to: " << m_writer.GetPath());
+  if (!m_liveSocket.empty())
+  {
+    RUN_LOG(m_log, SUMMARY, "Live rows published: " << m_writer.GetLivePublished()
+                                << " (dropped: " << m_writer.GetLiveDropped() << ")");
+  }
+  RUN_LOG(m_log, SUMMARY, "Animation saved to: " << animFileName);
+  RUN_LOG(m_log, SUMMARY, "Run summary saved to: " << m_outputPrefix << "-SUMMARY.json");
+  m_log.Close();
 }
 
 int main(int argc, char* argv[])
@@ -6,6 +6,9 @@
 # - Scenario 1: Default (moderate mobility, 3 m/s)
 # - Scenario 2: Low Mobility (1 m/s)
 # - Scenario 3: High Mobility (10 m/s)
+# Each scenario is replicated REPLICATIONS times with RNG run numbers
+# 1..REPLICATIONS; all protocols share a run number, so they pair up in the
+# replication analysis.
 # ============================================================================
 
 set -e  # Exit on error
@@ -23,6 +26,13 @@ PROTOCOLS=("AODV" "OLSR" "DSR" "DSDV")
 NODES=25
 SINKS=5
 SIMTIME=200
+REPLICATIONS="${REPLICATIONS:-5}"
+# Set to a PDR (e.g. 0.3) to screen every run on the abstract link layer
+# first; only runs whose screening PDR reaches it are re-run with full
+# 802.11. DSR has no screening mode and always runs in full. Screening
+# outputs are named <protocol>-SCREEN-*; pruned protocols are listed in
+# PRUNED.txt and left out of the plots and statistics.
+SCREEN_MIN_PDR="${SCREEN_MIN_PDR:-}"
 
 # ============================================================================
 # Functions
@@ -51,10 +61,28 @@ run_protocol() {
     local protocol=$1
     local speed=$2
     local scenario_name=$3
+    local run=$4
     
-    print_info "Running $protocol ($scenario_name)..."
+    local args="--protocol=$protocol --nWifis=$NODES --nSinks=$SINKS --nodeSpeed=$speed --totalTime=$SIMTIME --verbosity=summary --RngRun=$run"
+
+    if [[ -n "$SCREEN_MIN_PDR" && "$protocol" != "DSR" ]]; then
+        print_info "Screening $protocol ($scenario_name, run $run)..."
+        if ! ./ns3 run "$SIM $args --logFile=${protocol}-SCREEN-RUN.log --fidelity=screen" > /dev/null 2>&1; then
+            print_error "$protocol screening failed"
+            return 1
+        fi
+        local pdr
+        pdr=$(python3 -c "import json, sys; print(json.load(open(sys.argv[1]))['metrics']['pdr'])" "${protocol}-SCREEN-SUMMARY.json")
+        if ! awk -v pdr="$pdr" -v min="$SCREEN_MIN_PDR" 'BEGIN { exit !(pdr >= min) }'; then
+            print_info "$protocol pruned: screening PDR $pdr < $SCREEN_MIN_PDR"
+            echo "$protocol screening PDR $pdr < $SCREEN_MIN_PDR" >> PRUNED.txt
+            return 0
+        fi
+    fi
+
+    print_info "Running $protocol ($scenario_name, run $run)..."
     
-    if ./ns3 run "$SIM --protocol=$protocol --nWifis=$NODES --nSinks=$SINKS --nodeSpeed=$speed --totalTime=$SIMTIME" > /dev/null 2>&1; then
+    if ./ns3 run "$SIM $args --logFile=${protocol}-RUN.log" > /dev/null 2>&1; then
         if [[ -f "${protocol}-OUTPUT.csv" ]]; then
             print_success "$protocol completed"
         else
@@ -70,24 +98,35 @@ run_protocol() {
 save_results() {
     local scenario_dir=$1
     
-    print_info "Generating plots..."
-    gnuplot compare.gnuplot 2>/dev/null
+    # compare.gnuplot reads all four protocols' CSVs by name
+    if [[ -f PRUNED.txt ]]; then
+        print_info "Skipping compare.gnuplot: protocols were pruned (see PRUNED.txt)"
+    else
+        print_info "Generating plots..."
+        gnuplot compare.gnuplot 2>/dev/null || print_error "gnuplot failed"
+    fi
     
     print_info "Running statistical analysis..."
     python3 analyze_results.py > /dev/null 2>&1
     
     print_info "Saving results to $scenario_dir..."
+    mkdir -p "$scenario_dir"
     cp *-OUTPUT.csv "$scenario_dir/"
-    cp MANET-Comparison.pdf "$scenario_dir/"
+    cp *-SUMMARY.json "$scenario_dir/"
+    cp *-RUN.log "$scenario_dir/" 2>/dev/null || true
+    if [[ -f MANET-Comparison.pdf ]]; then
+        cp MANET-Comparison.pdf "$scenario_dir/"
+    fi
     cp *-ANIM.xml "$scenario_dir/" 2>/dev/null || true
     cp statistics_summary.txt "$scenario_dir/"
+    cp PRUNED.txt "$scenario_dir/" 2>/dev/null || true
     cp -r plots "$scenario_dir/" 2>/dev/null || true
     
     print_success "Results saved"
 }
 
 cleanup() {
-    rm -f *-OUTPUT.csv *-ANIM.xml *.pdf statistics_summary.txt 2>/dev/null || true
+    rm -f *-OUTPUT.csv *-SUMMARY.json *-RUN.log *-ANIM.xml *.pdf statistics_summary.txt PRUNED.txt 2>/dev/null || true
     rm -rf plots/ 2>/dev/null || true
 }
 
@@ -99,10 +138,35 @@ show_summary() {
     echo -e "${BLUE}Results for $scenario:${NC}"
     echo "----------------------------------------"
     if [[ -f "$stats_file" ]]; then
-        grep -A 5 "COMPARATIVE SUMMARY" "$stats_file" | tail -6
+        grep -E "is better\)|Ranking:" "$stats_file" || true
     else
         echo "Statistics file not found"
     fi
+    if ls "$(dirname "$stats_file")"/run*/PRUNED.txt > /dev/null 2>&1; then
+        echo "Pruned by screening:"
+        for pruned in "$(dirname "$stats_file")"/run*/PRUNED.txt; do
+            sed "s|^|  $(basename "$(dirname "$pruned")"): |" "$pruned"
+        done
+    fi
+}
+
+# Runs every protocol once per replication into <dir>/run<N>, then compares
+# the protocols across replications into <dir>/statistics_summary.txt.
+run_scenario() {
+    local speed=$1
+    local scenario_name=$2
+    local scenario_dir=$3
+
+    for ((RUN = 1; RUN <= REPLICATIONS; RUN++)); do
+        cleanup
+        for PROTO in "${PROTOCOLS[@]}"; do
+            run_protocol "$PROTO" "$speed" "$scenario_name" "$RUN"
+        done
+        save_results "$scenario_dir/run$RUN"
+    done
+
+    print_info "Comparing protocols across $REPLICATIONS replications..."
+    python3 analyze_results.py --results "$scenario_dir" > /dev/null 2>&1
 }
 
 # ============================================================================
@@ -112,6 +176,10 @@ show_summary() {
 print_header "MANET 3-Scenario Comparison Suite"
 echo "Nodes: $NODES | Flows: $SINKS | Duration: ${SIMTIME}s"
 echo "Protocols: ${PROTOCOLS[@]}"
+echo "Replications per scenario: $REPLICATIONS (RngRun 1-$REPLICATIONS)"
+if [[ -n "$SCREEN_MIN_PDR" ]]; then
+    echo "Screening: full runs only where the screening PDR >= $SCREEN_MIN_PDR"
+fi
 echo ""
 echo "Scenarios:"
 echo "  1. Default (Speed: 0-3 m/s)"
@@ -138,39 +206,21 @@ START_TIME=$(date +%s)
 # SCENARIO 1: DEFAULT (Moderate Mobility)
 # ============================================================================
 print_header "SCENARIO 1: Default Configuration (3 m/s)"
-cleanup
-
-for PROTO in "${PROTOCOLS[@]}"; do
-    run_protocol "$PROTO" 3.0 "Default"
-done
-
-save_results "results/scenario1_default"
+run_scenario 3.0 "Default" "results/scenario1_default"
 show_summary "Scenario 1" "results/scenario1_default/statistics_summary.txt"
 
 # ============================================================================
 # SCENARIO 2: LOW MOBILITY
 # ============================================================================
 print_header "SCENARIO 2: Low Mobility (1 m/s)"
-cleanup
-
-for PROTO in "${PROTOCOLS[@]}"; do
-    run_protocol "$PROTO" 1.0 "Low Mobility"
-done
-
-save_results "results/scenario2_low_mobility"
+run_scenario 1.0 "Low Mobility" "results/scenario2_low_mobility"
 show_summary "Scenario 2" "results/scenario2_low_mobility/statistics_summary.txt"
 
 # ============================================================================
 # SCENARIO 3: HIGH MOBILITY
 # ============================================================================
 print_header "SCENARIO 3: High Mobility (10 m/s)"
-cleanup
-
-for PROTO in "${PROTOCOLS[@]}"; do
-    run_protocol "$PROTO" 10.0 "High Mobility"
-done
-
-save_results "results/scenario3_high_mobility"
+run_scenario 10.0 "High Mobility" "results/scenario3_high_mobility"
 show_summary "Scenario 3" "results/scenario3_high_mobility/statistics_summary.txt"
 
 # ============================================================================
@@ -198,10 +248,9 @@ echo "  → results/scenario2_low_mobility/"
 echo "  → results/scenario3_high_mobility/"
 echo ""
 echo "Each directory contains:"
-echo "  - CSV files with raw data"
-echo "  - MANET-Comparison.pdf (plots)"
-echo "  - statistics_summary.txt (detailed stats)"
-echo "  - plots/ directory (Python visualizations)"
+echo "  - run1 ... run$REPLICATIONS: CSV files, MANET-Comparison.pdf, per-run"
+echo "    statistics_summary.txt and plots/ of one replication"
+echo "  - statistics_summary.txt (comparison across replications)"
 echo ""
 
 # Generate comparison summary
@@ -220,7 +269,7 @@ SCENARIO 1: DEFAULT (Speed: 0-3 m/s)
 EOF
 
 if [[ -f "results/scenario1_default/statistics_summary.txt" ]]; then
-    grep -A 5 "Protocol" "results/scenario1_default/statistics_summary.txt" | head -6 >> "$SUMMARY_FILE"
+    grep -E "is better\)|Ranking:" "results/scenario1_default/statistics_summary.txt" >> "$SUMMARY_FILE" || true
 fi
 
 cat >> "$SUMMARY_FILE" << 'EOF'
@@ -230,7 +279,7 @@ SCENARIO 2: LOW MOBILITY (Speed: 0-1 m/s)
 EOF
 
 if [[ -f "results/scenario2_low_mobility/statistics_summary.txt" ]]; then
-    grep -A 5 "Protocol" "results/scenario2_low_mobility/statistics_summary.txt" | head -6 >> "$SUMMARY_FILE"
+    grep -E "is better\)|Ranking:" "results/scenario2_low_mobility/statistics_summary.txt" >> "$SUMMARY_FILE" || true
 fi
 
 cat >> "$SUMMARY_FILE" << 'EOF'
@@ -240,7 +289,7 @@ SCENARIO 3: HIGH MOBILITY (Speed: 0-10 m/s)
 EOF
 
 if [[ -f "results/scenario3_high_mobility/statistics_summary.txt" ]]; then
-    grep -A 5 "Protocol" "results/scenario3_high_mobility/statistics_summary.txt" | head -6 >> "$SUMMARY_FILE"
+    grep -E "is better\)|Ranking:" "results/scenario3_high_mobility/statistics_summary.txt" >> "$SUMMARY_FILE" || true
 fi
 
 cat >> "$SUMMARY_FILE" << 'EOF'
@@ -284,7 +333,7 @@ cat "$SUMMARY_FILE"
 echo ""
 print_header "Next Steps"
 echo "1. Review results in results/ directory"
-echo "2. Open PDF plots: xdg-open results/scenario1_default/MANET-Comparison.pdf"
+echo "2. Open PDF plots: xdg-open results/scenario1_default/run1/MANET-Comparison.pdf"
 echo "3. Analyze statistics: cat results/FINAL_COMPARISON.txt"
 echo "4. Use these results to write your research paper"
 echo ""